@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "parallel_bfs.hpp"
+
+namespace parallel_bfs {
+
+// Receives every level of a bfs_async traversal as soon as it is complete
+typedef std::function<void(std::size_t depth,
+                           const std::vector<VertIdx_t> &level)>
+    LevelCallback;
+
+struct BfsProgress {
+    // Deepest level whose vertices have all been discovered
+    std::size_t depth = 0;
+    // Vertices in the levels up to depth
+    std::size_t discovered = 0;
+    bool done = false;
+    // Set with done when opts.cancel or opts.deadline stopped the traversal
+    bool partial = false;
+};
+
+namespace impl {
+namespace async {
+// Traversal state shared by a BfsHandle and the thread driving it
+struct AsyncState {
+    VertIdx_t start;
+    std::vector<std::size_t> dist;
+    LevelCallback on_level;
+    // Levels expanded so far, only written between levels
+    std::atomic<std::size_t> expanded{0};
+
+    std::mutex mutex;
+    BfsProgress progress; // guarded by mutex, done is left unset
+
+    // Makes level depth visible to progress() and streams it downstream
+    void publish(std::size_t depth, const std::vector<VertIdx_t> &level)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            progress.depth = depth;
+            progress.discovered += level.size();
+        }
+        if (on_level) {
+            on_level(depth, level);
+        }
+    }
+};
+
+/**
+ * @brief Per-thread visitor of bfs_async: stamps the depth of each vertex it
+ * discovers and buffers it, and the merged clone publishes the buffered
+ * level when the level ends.
+ */
+class LevelTracker : public boost::default_bfs_visitor {
+  private:
+    AsyncState *_state;
+    std::vector<VertIdx_t> _level;
+
+  public:
+    explicit LevelTracker(AsyncState &state) : _state(&state) {}
+
+    template <typename Vertex, typename Graph>
+    void discover_vertex(Vertex u, const Graph &)
+    {
+        if (u == _state->start) {
+            return;
+        }
+        _state->dist[u] =
+            _state->expanded.load(std::memory_order_relaxed) + 1;
+        _level.push_back(u);
+    }
+
+    void merge(LevelTracker &other)
+    {
+        _level.insert(_level.end(), other._level.begin(), other._level.end());
+        other._level.clear();
+    }
+
+    // Forgets the depths of a level cut short by a stop
+    void discard_level()
+    {
+        for (VertIdx_t idx : _level) {
+            _state->dist[idx] = UNREACHED;
+        }
+        _level.clear();
+    }
+
+    void end_level()
+    {
+        // The last expansion of every search finds nothing
+        if (_level.empty()) {
+            return;
+        }
+        std::size_t depth =
+            _state->expanded.fetch_add(1, std::memory_order_relaxed) + 1;
+        _state->publish(depth, _level);
+        _level.clear();
+    }
+};
+} // namespace async
+} // namespace impl
+
+/**
+ * @brief Handle to a traversal started by bfs_async. progress(), done() and
+ * wait() stay valid after get(), which moves the depths out and so returns
+ * them only once. Destroying the last copy waits for the traversal to end.
+ */
+class BfsHandle {
+  private:
+    std::shared_ptr<impl::async::AsyncState> _state;
+    std::shared_future<void> _done;
+
+  public:
+    BfsHandle(std::shared_ptr<impl::async::AsyncState> state,
+              std::shared_future<void> done)
+        : _state(std::move(state)), _done(std::move(done))
+    {
+    }
+
+    bool done() const
+    {
+        return _done.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready;
+    }
+
+    // Snapshot of the levels complete so far; final once done is set
+    BfsProgress progress() const
+    {
+        bool finished = done();
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        BfsProgress res = _state->progress;
+        res.done = finished;
+        return res;
+    }
+
+    void wait() const { _done.wait(); }
+
+    /**
+     * @brief Waits for the traversal and returns the depth of every vertex,
+     * UNREACHED for vertices it did not reach. A partial traversal only
+     * reports the vertices of its complete levels. Rethrows whatever the
+     * traversal threw.
+     */
+    std::vector<std::size_t> get()
+    {
+        _done.get();
+        return std::move(_state->dist);
+    }
+};
+
+/**
+ * @brief Starts the engine of the options overload of breadth_first_search
+ * on its own thread and returns at once. The traversal dispatches onto the
+ * shared pool like any other caller, so several can be in flight together,
+ * sharing its workers. on_level, when set, gets every level from that thread
+ * once the level is complete, the start vertex being level 0, so results can
+ * be streamed while later levels are still expanding; a level cut short by
+ * opts.cancel or opts.deadline is never passed on. G, reverse, opts.parent
+ * and opts.cancel must outlive the handle.
+ */
+template <typename GraphType>
+BfsHandle bfs_async(const GraphType &G, VertIdx_t start,
+                    const BfsOptions &opts = {}, LevelCallback on_level = {},
+                    const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    using namespace impl::async;
+
+    auto state = std::make_shared<AsyncState>();
+    state->start = start;
+    state->on_level = std::move(on_level);
+    auto drive = [&G, start, opts, reverse, state]() {
+        state->dist.assign(boost::num_vertices(G), UNREACHED);
+        state->dist[start] = 0;
+        state->publish(0, std::vector<VertIdx_t>{start});
+
+        impl::ThreadPool &pool = impl::ThreadPool::global();
+        impl::ThreadPool::ScopedDispatch dispatch(pool, opts.threads,
+                                                  opts.wait);
+        auto make_tracker = [&](std::size_t) { return LevelTracker(*state); };
+        impl::ThreadVisitors<LevelTracker> trackers(pool.concurrency(),
+                                                    make_tracker);
+        BfsOutcome outcome =
+            breadth_first_search(G, start, trackers, opts, reverse);
+        if (!outcome.complete) {
+            trackers.merge_clones();
+            trackers.merged().discard_level();
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->progress.partial = true;
+        }
+    };
+    return BfsHandle(state, std::async(std::launch::async, drive).share());
+}
+} // namespace parallel_bfs
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "parallel_bfs.hpp"
+
+namespace parallel_bfs {
+
+struct PathResult {
+    bool found = false;
+    // Edges on the path, UNREACHED when there is none
+    std::size_t distance = UNREACHED;
+    // Vertices from source to target
+    std::vector<VertIdx_t> path;
+};
+
+namespace impl {
+namespace bidirectional {
+// Frontier vertices per chunk of a level expansion
+constexpr std::size_t EXPAND_CHUNK = 64;
+
+enum Side { FORWARD, BACKWARD };
+
+/**
+ * @brief Which search reached each vertex, with its parent and depth there.
+ * Like EpochVisitedSet, the arrays belong to the calling thread and a new
+ * search only bumps the epoch: forward marks are 2 * epoch, backward marks
+ * 2 * epoch + 1, and parent and depth are only valid for marked vertices.
+ */
+class SideMarks {
+  private:
+    struct Storage {
+        std::vector<std::atomic<std::uint32_t>> marks;
+        std::unique_ptr<VertIdx_t[]> parent; // left uninitialised
+        std::unique_ptr<std::size_t[]> depth; // left uninitialised
+        std::uint32_t epoch = 0;
+    };
+
+    static constexpr std::uint32_t MAX_EPOCH = ~std::uint32_t(0) / 2 - 1;
+
+    Storage &_storage;
+    std::uint32_t _forward;
+
+    static Storage &_thread_storage()
+    {
+        static thread_local Storage storage;
+        return storage;
+    }
+
+  public:
+    explicit SideMarks(std::size_t vert_cnt) : _storage(_thread_storage())
+    {
+        if (_storage.marks.size() < vert_cnt || _storage.epoch == MAX_EPOCH) {
+            _storage.marks = std::vector<std::atomic<std::uint32_t>>(vert_cnt);
+            _storage.parent.reset(new VertIdx_t[vert_cnt]);
+            _storage.depth.reset(new std::size_t[vert_cnt]);
+            _storage.epoch = 0;
+        }
+        _storage.epoch++;
+        _forward = 2 * _storage.epoch;
+    }
+
+    std::uint32_t mark(Side side) const { return _forward + side; }
+
+    // Side that reached idx, or a mark below any side's when none did
+    std::uint32_t owner(VertIdx_t idx) const
+    {
+        return _storage.marks[idx].load(std::memory_order_relaxed);
+    }
+
+    bool is_marked(std::uint32_t owner) const { return owner >= _forward; }
+
+    // Claims idx for side, returns whether this call did
+    bool try_claim(VertIdx_t idx, Side side, VertIdx_t parent,
+                   std::size_t depth)
+    {
+        std::uint32_t curr = owner(idx);
+        if (is_marked(curr) ||
+            !_storage.marks[idx].compare_exchange_strong(
+                curr, mark(side), std::memory_order_relaxed)) {
+            return false;
+        }
+        _storage.parent[idx] = parent;
+        _storage.depth[idx] = depth;
+        return true;
+    }
+
+    VertIdx_t parent(VertIdx_t idx) const { return _storage.parent[idx]; }
+    std::size_t depth(VertIdx_t idx) const { return _storage.depth[idx]; }
+};
+
+// Shortest connection found by one thread: an edge from a forward to a
+// backward vertex
+struct Meeting {
+    std::size_t distance = UNREACHED;
+    VertIdx_t forward;
+    VertIdx_t backward;
+};
+
+/**
+ * @brief Expands one full level of side. Neighbours already reached by the
+ * other side are meetings, of which each thread keeps its shortest; the rest
+ * are claimed for side. Returns the summed degree of the next level, in the
+ * direction side will expand it.
+ */
+template <typename GraphType>
+static std::size_t
+_expand(const GraphType &G, const ReverseGraph<GraphType> &reverse,
+        Side side, SideMarks &marks, SparseFrontier &curr_lvl,
+        std::vector<std::vector<VertIdx_t>> &next_lvl,
+        std::vector<std::size_t> &next_degrees, std::vector<Meeting> &meetings)
+{
+    ThreadPool &pool = ThreadPool::global();
+    std::uint32_t other = marks.mark(side == FORWARD ? BACKWARD : FORWARD);
+    std::fill(next_degrees.begin(), next_degrees.end(), 0);
+
+    auto visit = [&](VertIdx_t u, VertIdx_t v, std::size_t tid) {
+        std::uint32_t owner = marks.owner(v);
+        if (owner == other) {
+            std::size_t dist = marks.depth(u) + 1 + marks.depth(v);
+            if (dist < meetings[tid].distance) {
+                meetings[tid] = (side == FORWARD) ? Meeting{dist, u, v}
+                                                  : Meeting{dist, v, u};
+            }
+        } else if (marks.try_claim(v, side, u, marks.depth(u) + 1)) {
+            next_lvl[tid].push_back(v);
+            next_degrees[tid] += (side == FORWARD) ? boost::out_degree(v, G)
+                                                   : reverse.in_degree(v);
+        }
+    };
+    auto expand = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+        for (std::size_t i = lo; i < hi; i++) {
+            VertIdx_t u = curr_lvl[i];
+            if (side == FORWARD) {
+                const auto &edges = boost::out_edges(u, G);
+                for (auto e = edges.first; e != edges.second; e++) {
+                    visit(u, boost::target(*e, G), tid);
+                }
+            } else {
+                auto edges = reverse.in_edges(u);
+                for (auto e = edges.first; e != edges.second; e++) {
+                    visit(u, boost::source(*e, G), tid);
+                }
+            }
+        }
+    };
+    pool.parallel_for(0, curr_lvl.size(), EXPAND_CHUNK, expand);
+    curr_lvl.assign(pool, next_lvl);
+    return std::accumulate(next_degrees.begin(), next_degrees.end(),
+                           std::size_t(0));
+}
+} // namespace bidirectional
+} // namespace impl
+
+/**
+ * @brief Shortest path from source to target, searching forward from source
+ * and backward from target over reverse. Each round expands a full level of
+ * whichever side has fewer edges to scan, and the search stops at the end of
+ * the first level where the two sides meet, so on small-world graphs it
+ * touches a small ball around each end instead of the whole graph. Like the
+ * depth-bounded engine it only touches vertices it reaches. reverse is built
+ * for this call when null; pass one in when running many queries.
+ */
+template <typename GraphType>
+PathResult bidirectional_bfs(const GraphType &G, VertIdx_t source,
+                             VertIdx_t target, const BfsOptions &opts = {},
+                             const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    using namespace impl::bidirectional;
+
+    impl::ThreadPool &pool = impl::ThreadPool::global();
+    impl::ThreadPool::ScopedDispatch dispatch(pool, opts.threads, opts.wait);
+    PathResult res;
+    if (source == target) {
+        res.found = true;
+        res.distance = 0;
+        res.path.push_back(source);
+        return res;
+    }
+
+    std::unique_ptr<ReverseGraph<GraphType>> owned_reverse;
+    if (reverse == nullptr) {
+        owned_reverse = std::make_unique<ReverseGraph<GraphType>>(G);
+        reverse = owned_reverse.get();
+    }
+
+    std::size_t thread_cnt = pool.concurrency();
+    SideMarks marks(boost::num_vertices(G));
+    impl::SparseFrontier lvls[2];
+    std::size_t lvl_degrees[2] = {boost::out_degree(source, G),
+                                  reverse->in_degree(target)};
+    std::vector<std::vector<VertIdx_t>> next_lvl(thread_cnt);
+    std::vector<std::size_t> next_degrees(thread_cnt);
+    std::vector<Meeting> meetings(thread_cnt);
+    marks.try_claim(source, FORWARD, source, 0);
+    marks.try_claim(target, BACKWARD, target, 0);
+    lvls[FORWARD].push_back(source);
+    lvls[BACKWARD].push_back(target);
+
+    Meeting best;
+    while (!lvls[FORWARD].empty() && !lvls[BACKWARD].empty()) {
+        Side side =
+            (lvl_degrees[FORWARD] <= lvl_degrees[BACKWARD]) ? FORWARD
+                                                              : BACKWARD;
+        lvl_degrees[side] = _expand(G, *reverse, side, marks, lvls[side],
+                                    next_lvl, next_degrees, meetings);
+        for (const Meeting &meeting : meetings) {
+            if (meeting.distance < best.distance) {
+                best = meeting;
+            }
+        }
+        if (best.distance != UNREACHED) {
+            break;
+        }
+    }
+    if (best.distance == UNREACHED) {
+        return res;
+    }
+
+    res.found = true;
+    res.distance = best.distance;
+    for (VertIdx_t idx = best.forward; idx != source;
+         idx = marks.parent(idx)) {
+        res.path.push_back(idx);
+    }
+    res.path.push_back(source);
+    std::reverse(res.path.begin(), res.path.end());
+    for (VertIdx_t idx = best.backward; idx != target;
+         idx = marks.parent(idx)) {
+        res.path.push_back(idx);
+    }
+    res.path.push_back(target);
+    return res;
+}
+} // namespace parallel_bfs
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "thread_pool.hpp"
+
+namespace parallel_bfs {
+namespace impl {
+
+/**
+ * @brief Packed bit set with atomic per-bit updates. Bits are only ever
+ * ordered by the level barriers around them, so all accesses are relaxed.
+ * The words are first zeroed from the shared pool, one page per chunk, so
+ * under ThreadPool::enable_numa each page lands on the node whose threads
+ * sweep that vertex range.
+ */
+class AtomicBitmap {
+  private:
+    // Words per page, the unit of first-touch placement
+    static constexpr std::size_t PAGE_WORDS = 4096 / sizeof(std::uint64_t);
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> _words; // see constructor
+    std::size_t _word_cnt;
+    std::size_t _size;
+
+    static std::uint64_t _mask(std::size_t i)
+    {
+        return std::uint64_t(1) << (i % 64);
+    }
+
+  public:
+    static constexpr std::size_t WORD_BITS = 64;
+
+    explicit AtomicBitmap(std::size_t size = 0)
+        : _word_cnt((size + WORD_BITS - 1) / WORD_BITS), _size(size)
+    {
+        _words.reset(new std::atomic<std::uint64_t>[_word_cnt]);
+        ThreadPool::global().parallel_for(
+            0, _word_cnt, PAGE_WORDS,
+            [&](std::size_t lo, std::size_t hi, std::size_t) {
+                for (std::size_t w = lo; w < hi; w++) {
+                    _words[w].store(0, std::memory_order_relaxed);
+                }
+            });
+    }
+
+    std::size_t size() const { return _size; }
+    std::size_t word_count() const { return _word_cnt; }
+
+    bool test(std::size_t i) const
+    {
+        return _words[i / WORD_BITS].load(std::memory_order_relaxed) &
+               _mask(i);
+    }
+
+    /**
+     * @brief Sets bit i and returns whether this call changed it. The plain
+     * load first keeps already set bits from bouncing the cache line.
+     */
+    bool test_and_set(std::size_t i)
+    {
+        std::atomic<std::uint64_t> &word = _words[i / WORD_BITS];
+        if (word.load(std::memory_order_relaxed) & _mask(i)) {
+            return false;
+        }
+        return !(word.fetch_or(_mask(i), std::memory_order_relaxed) &
+                 _mask(i));
+    }
+
+    void set(std::size_t i)
+    {
+        _words[i / WORD_BITS].fetch_or(_mask(i), std::memory_order_relaxed);
+    }
+
+    // Starts loading the word of bit i for a coming test_and_set
+    void prefetch(std::size_t i) const
+    {
+        __builtin_prefetch(&_words[i / WORD_BITS], 1);
+    }
+
+    void reset(std::size_t i)
+    {
+        _words[i / WORD_BITS].fetch_and(~_mask(i), std::memory_order_relaxed);
+    }
+
+    std::uint64_t word(std::size_t w) const
+    {
+        return _words[w].load(std::memory_order_relaxed);
+    }
+
+    void set_word(std::size_t w, std::uint64_t bits)
+    {
+        _words[w].store(bits, std::memory_order_relaxed);
+    }
+
+    void clear()
+    {
+        for (std::size_t w = 0; w < _word_cnt; w++) {
+            _words[w].store(0, std::memory_order_relaxed);
+        }
+    }
+};
+} // namespace impl
+} // namespace parallel_bfs
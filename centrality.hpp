@@ -0,0 +1,543 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "multi_source_bfs.hpp"
+#include "parallel_bfs.hpp"
+
+namespace parallel_bfs {
+
+struct BetweennessOptions {
+    // Sources sampled for an estimate scaled up to all sources, 0 for the
+    // exact result over every source
+    std::size_t samples = 0;
+    std::uint32_t seed = 1;
+    // Give each thread whole sources to run serially instead of splitting
+    // every source's levels across threads. Better when levels are narrow,
+    // at the cost of per-thread arrays
+    bool across_sources = false;
+};
+
+struct ClosenessOptions {
+    // Sum the inverse distances to the reached vertices instead of inverting
+    // the sum of the distances
+    bool harmonic = false;
+};
+
+namespace impl {
+namespace centrality {
+// Frontier vertices per chunk of a level
+constexpr std::size_t EXPAND_CHUNK = 64;
+// Vertices per chunk of the vertex loops
+constexpr std::size_t VERT_CHUNK = 1024;
+
+/**
+ * @brief Arrays of the level-parallel Brandes pass. Path counts are integers
+ * as in boost::brandes_betweenness_centrality. A pass only resets the
+ * vertices it reached.
+ */
+struct LevelState {
+    std::vector<std::size_t> dist;
+    std::vector<std::atomic<std::uint64_t>> sigma;
+    std::vector<double> delta;
+    // Reached vertices level by level, level d in [lvl_begin[d],
+    // lvl_begin[d + 1])
+    std::vector<VertIdx_t> order;
+    std::vector<std::size_t> lvl_begin;
+
+    explicit LevelState(std::size_t vert_cnt)
+        : dist(vert_cnt, UNREACHED), sigma(vert_cnt), delta(vert_cnt, 0.0)
+    {
+    }
+};
+
+/**
+ * @brief Per-thread visitor of the forward phase: stamps the depth of each
+ * vertex it discovers and buffers it, and the merged clone appends the
+ * buffered level to the order when the level ends.
+ */
+class LevelRecorder : public boost::default_bfs_visitor {
+  private:
+    LevelState *_state;
+    VertIdx_t _source;
+    std::vector<VertIdx_t> _level;
+
+  public:
+    LevelRecorder(LevelState &state, VertIdx_t source)
+        : _state(&state), _source(source)
+    {
+    }
+
+    template <typename Vertex, typename Graph>
+    void discover_vertex(Vertex u, const Graph &)
+    {
+        if (u == _source) {
+            return;
+        }
+        // Only end_level grows lvl_begin, between levels
+        _state->dist[u] = _state->lvl_begin.size() - 1;
+        _level.push_back(u);
+    }
+
+    void merge(LevelRecorder &other)
+    {
+        _level.insert(_level.end(), other._level.begin(), other._level.end());
+        other._level.clear();
+    }
+
+    void end_level()
+    {
+        if (_level.empty()) {
+            return;
+        }
+        _state->order.insert(_state->order.end(), _level.begin(),
+                             _level.end());
+        _state->lvl_begin.push_back(_state->order.size());
+        _level.clear();
+    }
+};
+
+// Arrays of one thread's serial Brandes passes, with its own scores
+struct SerialState {
+    std::vector<std::size_t> dist;
+    std::vector<std::uint64_t> sigma;
+    std::vector<double> delta;
+    std::vector<VertIdx_t> order; // doubles as the BFS queue
+    std::vector<double> score;
+
+    explicit SerialState(std::size_t vert_cnt)
+        : dist(vert_cnt, UNREACHED), sigma(vert_cnt, 0),
+          delta(vert_cnt, 0.0), score(vert_cnt, 0.0)
+    {
+    }
+};
+
+/**
+ * @brief Adds the dependencies of source to score. The engine picked by opts
+ * finds the levels; the path counts are then pushed one level down at a
+ * time, and the dependencies pulled over out-edges from the level below,
+ * deepest level first, so no count or score is written twice at once.
+ */
+template <typename GraphType>
+static void _level_pass(const GraphType &G, VertIdx_t source,
+                        const BfsOptions &opts,
+                        const ReverseGraph<GraphType> *reverse,
+                        LevelState &state, std::vector<double> &score)
+{
+    ThreadPool &pool = ThreadPool::global();
+    state.order.assign(1, source);
+    state.lvl_begin.assign({0, 1});
+    state.dist[source] = 0;
+    auto make_recorder = [&](std::size_t) {
+        return LevelRecorder(state, source);
+    };
+    ThreadVisitors<LevelRecorder> recorders(pool.concurrency(),
+                                            make_recorder);
+    breadth_first_search(G, source, recorders, opts, reverse);
+
+    std::size_t lvl_cnt = state.lvl_begin.size() - 1;
+    state.sigma[source].store(1, std::memory_order_relaxed);
+    for (std::size_t d = 0; d + 1 < lvl_cnt; d++) {
+        pool.parallel_for(
+            state.lvl_begin[d], state.lvl_begin[d + 1], EXPAND_CHUNK,
+            [&](std::size_t lo, std::size_t hi, std::size_t) {
+                for (std::size_t i = lo; i < hi; i++) {
+                    VertIdx_t u = state.order[i];
+                    std::uint64_t paths =
+                        state.sigma[u].load(std::memory_order_relaxed);
+                    const auto &out = boost::out_edges(u, G);
+                    for (auto e = out.first; e != out.second; e++) {
+                        VertIdx_t v = boost::target(*e, G);
+                        if (state.dist[v] == d + 1) {
+                            state.sigma[v].fetch_add(
+                                paths, std::memory_order_relaxed);
+                        }
+                    }
+                }
+            });
+    }
+
+    for (std::size_t d = lvl_cnt - 1; d > 0; d--) {
+        pool.parallel_for(
+            state.lvl_begin[d], state.lvl_begin[d + 1], EXPAND_CHUNK,
+            [&](std::size_t lo, std::size_t hi, std::size_t) {
+                for (std::size_t i = lo; i < hi; i++) {
+                    VertIdx_t v = state.order[i];
+                    double paths =
+                        state.sigma[v].load(std::memory_order_relaxed);
+                    double dep = 0.0;
+                    const auto &out = boost::out_edges(v, G);
+                    for (auto e = out.first; e != out.second; e++) {
+                        VertIdx_t w = boost::target(*e, G);
+                        if (state.dist[w] == d + 1) {
+                            double w_paths = state.sigma[w].load(
+                                std::memory_order_relaxed);
+                            dep += paths / w_paths * (1.0 + state.delta[w]);
+                        }
+                    }
+                    state.delta[v] = dep;
+                    score[v] += dep;
+                }
+            });
+    }
+
+    pool.parallel_for(0, state.order.size(), VERT_CHUNK,
+                      [&](std::size_t lo, std::size_t hi, std::size_t) {
+                          for (std::size_t i = lo; i < hi; i++) {
+                              VertIdx_t v = state.order[i];
+                              state.dist[v] = UNREACHED;
+                              state.sigma[v].store(
+                                  0, std::memory_order_relaxed);
+                              state.delta[v] = 0.0;
+                          }
+                      });
+}
+
+// Adds the dependencies of source to state.score on the calling thread
+template <typename GraphType>
+static void _serial_pass(const GraphType &G, VertIdx_t source,
+                         SerialState &state)
+{
+    state.order.assign(1, source);
+    state.dist[source] = 0;
+    state.sigma[source] = 1;
+    for (std::size_t i = 0; i < state.order.size(); i++) {
+        VertIdx_t u = state.order[i];
+        const auto &out = boost::out_edges(u, G);
+        for (auto e = out.first; e != out.second; e++) {
+            VertIdx_t v = boost::target(*e, G);
+            if (state.dist[v] == UNREACHED) {
+                state.dist[v] = state.dist[u] + 1;
+                state.order.push_back(v);
+            }
+            if (state.dist[v] == state.dist[u] + 1) {
+                state.sigma[v] += state.sigma[u];
+            }
+        }
+    }
+
+    for (auto i = state.order.rbegin(); i != state.order.rend(); i++) {
+        VertIdx_t v = *i;
+        double paths = state.sigma[v];
+        const auto &out = boost::out_edges(v, G);
+        for (auto e = out.first; e != out.second; e++) {
+            VertIdx_t w = boost::target(*e, G);
+            if (state.dist[w] == state.dist[v] + 1) {
+                state.delta[v] +=
+                    paths / state.sigma[w] * (1.0 + state.delta[w]);
+            }
+        }
+        if (v != source) {
+            state.score[v] += state.delta[v];
+        }
+    }
+
+    for (VertIdx_t v : state.order) {
+        state.dist[v] = UNREACHED;
+        state.sigma[v] = 0;
+        state.delta[v] = 0.0;
+    }
+}
+
+// Every vertex, or samples distinct ones drawn with seed
+inline std::vector<VertIdx_t> _pick_sources(std::size_t vert_cnt,
+                                            std::size_t samples,
+                                            std::uint32_t seed)
+{
+    std::vector<VertIdx_t> sources(vert_cnt);
+    std::iota(sources.begin(), sources.end(), VertIdx_t(0));
+    if (samples == 0 || samples >= vert_cnt) {
+        return sources;
+    }
+    std::mt19937 rng(seed);
+    for (std::size_t i = 0; i < samples; i++) {
+        std::uniform_int_distribution<std::size_t> pick(i, vert_cnt - 1);
+        std::swap(sources[i], sources[pick(rng)]);
+    }
+    sources.resize(samples);
+    return sources;
+}
+
+// Running sums of one root's traversal
+struct RootSums {
+    std::size_t reached = 1; // the root itself
+    std::uint64_t farness = 0;
+    double inv_sum = 0.0;
+
+    void add_level(std::size_t depth, std::size_t cnt)
+    {
+        reached += cnt;
+        farness += std::uint64_t(depth) * cnt;
+        inv_sum += double(cnt) / depth;
+    }
+
+    static double closeness(std::size_t vert_cnt, std::size_t reached,
+                            std::uint64_t farness)
+    {
+        if (reached <= 1) {
+            return 0.0;
+        }
+        double others = reached - 1;
+        return others * others / ((vert_cnt - 1) * double(farness));
+    }
+
+    double score(bool harmonic, std::size_t vert_cnt) const
+    {
+        return harmonic ? inv_sum : closeness(vert_cnt, reached, farness);
+    }
+
+    /**
+     * @brief Highest score the root can still reach once every vertex up to
+     * depth is counted, the rest being at least depth + 1 away. Closeness is
+     * highest with none or all of the rest reached, as its numerator grows
+     * faster than its denominator only past some count.
+     */
+    double bound(bool harmonic, std::size_t vert_cnt, std::size_t depth) const
+    {
+        std::size_t rest = vert_cnt - reached;
+        if (harmonic) {
+            return inv_sum + double(rest) / (depth + 1);
+        }
+        std::uint64_t far_all = farness + std::uint64_t(depth + 1) * rest;
+        return std::max(closeness(vert_cnt, reached, farness),
+                        closeness(vert_cnt, vert_cnt, far_all));
+    }
+};
+
+/**
+ * @brief Runs the multi-source kernel from roots, a batch at a time, keeping
+ * only per-root sums. At the end of every level the per-thread counts are
+ * merged into them; a root whose level came out empty is done and goes to
+ * on_result(root, score), and a root whose bound falls below threshold() is
+ * dropped from the batch without a result.
+ */
+template <std::size_t WORDS, typename GraphType, typename ThresholdFunc,
+          typename ResultFunc>
+void _closeness(const GraphType &G, const std::vector<VertIdx_t> &roots,
+                bool harmonic, const BfsOptions &opts,
+                const ReverseGraph<GraphType> *reverse,
+                ThresholdFunc &&threshold, ResultFunc &&on_result)
+{
+    typedef SourceMask<WORDS> Mask;
+    constexpr std::size_t BATCH = Mask::BITS;
+
+    ThreadPool &pool = ThreadPool::global();
+    ThreadPool::ScopedDispatch dispatch(pool, opts.threads, opts.wait);
+    std::unique_ptr<ReverseGraph<GraphType>> owned_reverse;
+    if (reverse == nullptr) {
+        owned_reverse = std::make_unique<ReverseGraph<GraphType>>(G);
+        reverse = owned_reverse.get();
+    }
+
+    std::size_t vert_cnt = boost::num_vertices(G);
+    // Per-thread counts of the current level, merged by level
+    std::vector<std::array<std::size_t, BATCH>> level_cnts(
+        pool.concurrency());
+    for (std::size_t begin = 0; begin < roots.size(); begin += BATCH) {
+        std::size_t cnt = std::min(BATCH, roots.size() - begin);
+        std::array<RootSums, BATCH> sums{};
+        Mask live;
+        for (std::size_t i = 0; i < cnt; i++) {
+            live.set(i);
+        }
+
+        auto discover = [&](VertIdx_t, const Mask &mask, std::size_t depth,
+                            std::size_t tid) {
+            if (depth != 0) {
+                mask.for_each_bit([&](std::size_t i) { level_cnts[tid][i]++; });
+            }
+        };
+        auto level = [&](std::size_t depth) {
+            Mask stop;
+            if (depth == 0) {
+                return stop;
+            }
+            double min_score = threshold();
+            live.for_each_bit([&](std::size_t i) {
+                std::size_t found = 0;
+                for (auto &cnts : level_cnts) {
+                    found += cnts[i];
+                    cnts[i] = 0;
+                }
+                if (found == 0) {
+                    on_result(roots[begin + i], sums[i].score(harmonic,
+                                                              vert_cnt));
+                    stop.set(i);
+                    return;
+                }
+                sums[i].add_level(depth, found);
+                if (sums[i].bound(harmonic, vert_cnt, depth) < min_score) {
+                    stop.set(i);
+                }
+            });
+            live = live.without(stop);
+            return stop;
+        };
+        multi_source::_run_batch<WORDS>(G, *reverse, roots.data() + begin,
+                                        cnt, discover, level);
+
+        // The expansion that ended the batch found nothing
+        live.for_each_bit([&](std::size_t i) {
+            on_result(roots[begin + i], sums[i].score(harmonic, vert_cnt));
+        });
+    }
+}
+} // namespace centrality
+} // namespace impl
+
+/**
+ * @brief Brandes betweenness centrality of every vertex, unnormalised like
+ * boost::brandes_betweenness_centrality and equal to it up to floating-point
+ * rounding. By default each source is traversed by the engine the options
+ * overload of breadth_first_search picks for opts, with paths counted and
+ * dependencies accumulated level-synchronously on the pool;
+ * bc.across_sources instead runs whole sources serially, one per thread at a
+ * time. With bc.samples set, only that many random sources are used and the
+ * sums are scaled by vertices / samples. Only the thread, wait, direction
+ * and prefetch settings of opts apply.
+ */
+template <typename GraphType>
+std::vector<double>
+betweenness_centrality(const GraphType &G, const BetweennessOptions &bc = {},
+                       const BfsOptions &opts = {},
+                       const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    using namespace impl::centrality;
+
+    impl::ThreadPool &pool = impl::ThreadPool::global();
+    impl::ThreadPool::ScopedDispatch dispatch(pool, opts.threads, opts.wait);
+    std::size_t vert_cnt = boost::num_vertices(G);
+    std::vector<VertIdx_t> sources =
+        _pick_sources(vert_cnt, bc.samples, bc.seed);
+    std::vector<double> score(vert_cnt, 0.0);
+
+    if (!bc.across_sources) {
+        BfsOptions pass_opts;
+        pass_opts.threads = opts.threads;
+        pass_opts.wait = opts.wait;
+        pass_opts.direction_optimizing = opts.direction_optimizing;
+        pass_opts.alpha = opts.alpha;
+        pass_opts.beta = opts.beta;
+        pass_opts.prefetch_distance = opts.prefetch_distance;
+        LevelState state(vert_cnt);
+        for (VertIdx_t source : sources) {
+            _level_pass(G, source, pass_opts, reverse, state, score);
+        }
+    } else {
+        std::vector<SerialState> states(pool.concurrency(),
+                                        SerialState(vert_cnt));
+        pool.parallel_for(0, sources.size(), 1,
+                          [&](std::size_t lo, std::size_t hi,
+                              std::size_t tid) {
+                              for (std::size_t i = lo; i < hi; i++) {
+                                  _serial_pass(G, sources[i], states[tid]);
+                              }
+                          });
+        pool.parallel_for(0, vert_cnt, VERT_CHUNK,
+                          [&](std::size_t lo, std::size_t hi, std::size_t) {
+                              for (VertIdx_t v = lo; v < hi; v++) {
+                                  for (const SerialState &state : states) {
+                                      score[v] += state.score[v];
+                                  }
+                              }
+                          });
+    }
+
+    if (sources.size() < vert_cnt) {
+        double scale = double(vert_cnt) / sources.size();
+        for (double &val : score) {
+            val *= scale;
+        }
+    }
+    return score;
+}
+
+/**
+ * @brief Closeness centrality of every vertex over its out-distances,
+ * batching 64 * WORDS roots per shared multi-source traversal. With r
+ * vertices reachable from a vertex, itself included, at a distance sum of
+ * F, its closeness is (r - 1)^2 / ((n - 1) F), the Wasserman-Faust form
+ * that reduces to (n - 1) / F on strongly connected graphs and to 0 with
+ * nothing reachable. cc.harmonic gives the sum of 1 / distance over the
+ * reached vertices instead. reverse is built for this call when null.
+ */
+template <std::size_t WORDS = 4, typename GraphType>
+std::vector<double>
+closeness_centrality(const GraphType &G, const ClosenessOptions &cc = {},
+                     const BfsOptions &opts = {},
+                     const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    std::vector<VertIdx_t> roots(boost::num_vertices(G));
+    std::iota(roots.begin(), roots.end(), VertIdx_t(0));
+    std::vector<double> score(roots.size(), 0.0);
+    impl::centrality::_closeness<WORDS>(
+        G, roots, cc.harmonic, opts, reverse,
+        [] { return -std::numeric_limits<double>::infinity(); },
+        [&](VertIdx_t root, double val) { score[root] = val; });
+    return score;
+}
+
+/**
+ * @brief The k vertices of highest closeness_centrality, best first, ties
+ * broken by lower index. Roots go by decreasing out-degree, and a root is
+ * dropped as soon as its bound falls below the k-th best score so far, so
+ * most traversals stop after a few levels.
+ */
+template <std::size_t WORDS = 4, typename GraphType>
+std::vector<std::pair<VertIdx_t, double>>
+top_closeness_centrality(const GraphType &G, std::size_t k,
+                         const ClosenessOptions &cc = {},
+                         const BfsOptions &opts = {},
+                         const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    typedef std::pair<VertIdx_t, double> Ranked;
+    auto better = [](const Ranked &a, const Ranked &b) {
+        return a.second > b.second ||
+               (a.second == b.second && a.first < b.first);
+    };
+
+    if (k == 0) {
+        return {};
+    }
+    std::vector<VertIdx_t> roots(boost::num_vertices(G));
+    std::iota(roots.begin(), roots.end(), VertIdx_t(0));
+    std::stable_sort(roots.begin(), roots.end(),
+                     [&](VertIdx_t a, VertIdx_t b) {
+                         return boost::out_degree(a, G) >
+                                boost::out_degree(b, G);
+                     });
+    // Best k so far, the worst on top
+    std::priority_queue<Ranked, std::vector<Ranked>, decltype(better)> best(
+        better);
+    impl::centrality::_closeness<WORDS>(
+        G, roots, cc.harmonic, opts, reverse,
+        [&] {
+            return best.size() < k
+                       ? -std::numeric_limits<double>::infinity()
+                       : best.top().second;
+        },
+        [&](VertIdx_t root, double val) {
+            best.emplace(root, val);
+            if (best.size() > k) {
+                best.pop();
+            }
+        });
+
+    std::vector<Ranked> res;
+    for (; !best.empty(); best.pop()) {
+        res.push_back(best.top());
+    }
+    std::reverse(res.begin(), res.end());
+    return res;
+}
+} // namespace parallel_bfs
@@ -0,0 +1,552 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "parallel_bfs.hpp"
+
+namespace parallel_bfs {
+
+struct Components {
+    // A representative vertex of every vertex's component, the same for
+    // all vertices of a component and labelling itself
+    std::vector<VertIdx_t> label;
+    std::size_t count = 0;
+};
+
+// Strongly connected components and the DAG between them
+struct Condensation {
+    Components components;
+    // Component labels (from, to) of every pair of components joined by at
+    // least one edge, sorted and without duplicates
+    std::vector<std::pair<VertIdx_t, VertIdx_t>> edges;
+};
+
+namespace impl {
+namespace components {
+// Out-edges per vertex linked before looking for the giant component
+constexpr std::size_t NEIGHBOR_ROUNDS = 2;
+// Vertices whose components are counted to find the giant component
+constexpr std::size_t SAMPLE_CNT = 1024;
+// Vertices per chunk of the vertex loops
+constexpr std::size_t VERT_CHUNK = 1024;
+// Frontier vertices per chunk of the giant component BFS
+constexpr std::size_t EXPAND_CHUNK = 64;
+
+typedef std::vector<std::atomic<VertIdx_t>> Parents;
+
+/**
+ * @brief Joins the trees of u and v, always hanging the higher root below
+ * the lower one so that concurrent links cannot form cycles.
+ */
+inline void _link(Parents &comp, VertIdx_t u, VertIdx_t v)
+{
+    VertIdx_t p1 = comp[u].load(std::memory_order_relaxed);
+    VertIdx_t p2 = comp[v].load(std::memory_order_relaxed);
+    while (p1 != p2) {
+        VertIdx_t high = std::max(p1, p2);
+        VertIdx_t low = std::min(p1, p2);
+        VertIdx_t p_high = comp[high].load(std::memory_order_relaxed);
+        if (p_high == low) {
+            break;
+        }
+        if (p_high == high && comp[high].compare_exchange_strong(
+                                  p_high, low, std::memory_order_relaxed)) {
+            break;
+        }
+        p1 = comp[comp[high].load(std::memory_order_relaxed)].load(
+            std::memory_order_relaxed);
+        p2 = comp[low].load(std::memory_order_relaxed);
+    }
+}
+
+// Points every vertex straight at the root of its tree
+inline void _compress(ThreadPool &pool, Parents &comp)
+{
+    pool.parallel_for(0, comp.size(), VERT_CHUNK,
+                      [&](std::size_t lo, std::size_t hi, std::size_t) {
+                          for (VertIdx_t v = lo; v < hi; v++) {
+                              VertIdx_t p = comp[v].load();
+                              while (comp[p].load() != p) {
+                                  p = comp[p].load();
+                              }
+                              comp[v].store(p);
+                          }
+                      });
+}
+
+// Most common root among sampled vertices, and one sampled vertex below it
+inline std::pair<VertIdx_t, VertIdx_t> _sample_giant(const Parents &comp)
+{
+    std::mt19937 rng(27491095);
+    std::uniform_int_distribution<VertIdx_t> pick(0, comp.size() - 1);
+    std::unordered_map<VertIdx_t, std::size_t> freq;
+    std::pair<VertIdx_t, VertIdx_t> best(0, 0);
+    std::size_t best_cnt = 0;
+    for (std::size_t i = 0; i < SAMPLE_CNT; i++) {
+        VertIdx_t v = pick(rng);
+        VertIdx_t root = comp[v].load();
+        if (++freq[root] > best_cnt) {
+            best_cnt = freq[root];
+            best = {root, v};
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Marks in visited every vertex weakly connected to start, following
+ * out-edges and, when reverse is set, in-edges.
+ */
+template <typename GraphType>
+static void _weak_bfs(const GraphType &G,
+                      const ReverseGraph<GraphType> *reverse, VertIdx_t start,
+                      VisitedSet &visited)
+{
+    ThreadPool &pool = ThreadPool::global();
+    SparseFrontier curr_lvl;
+    std::vector<std::vector<VertIdx_t>> next_lvl(pool.concurrency());
+    auto expand = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+        for (std::size_t i = lo; i < hi; i++) {
+            VertIdx_t u = curr_lvl[i];
+            const auto &out = boost::out_edges(u, G);
+            for (auto e = out.first; e != out.second; e++) {
+                VertIdx_t v = boost::target(*e, G);
+                if (visited.try_discover(v)) {
+                    next_lvl[tid].push_back(v);
+                }
+            }
+            if (reverse == nullptr) {
+                continue;
+            }
+            auto in = reverse->in_edges(u);
+            for (auto e = in.first; e != in.second; e++) {
+                VertIdx_t v = boost::source(*e, G);
+                if (visited.try_discover(v)) {
+                    next_lvl[tid].push_back(v);
+                }
+            }
+        }
+    };
+
+    visited.discover(start);
+    curr_lvl.push_back(start);
+    while (!curr_lvl.empty()) {
+        pool.parallel_for(0, curr_lvl.size(), EXPAND_CHUNK, expand);
+        curr_lvl.assign(pool, next_lvl);
+    }
+}
+
+namespace strong {
+// Color of vertices whose component is known
+constexpr std::size_t DONE = ~std::size_t(0);
+// Partitions this large are split by parallel BFS, smaller ones by one
+// thread each, many at a time
+constexpr std::size_t PARALLEL_PART = 4096;
+
+typedef std::vector<std::atomic<std::size_t>> Colors;
+
+// Vertices still sharing a color, which holds every SCC it touches
+struct Partition {
+    std::vector<VertIdx_t> verts;
+    std::size_t color;
+};
+
+template <typename GraphType, typename Func>
+void _for_each_neighbour(const GraphType &G,
+                         const ReverseGraph<GraphType> &reverse,
+                         bool backward, VertIdx_t u, Func &&func)
+{
+    if (!backward) {
+        const auto &out = boost::out_edges(u, G);
+        for (auto e = out.first; e != out.second; e++) {
+            func(boost::target(*e, G));
+        }
+    } else {
+        auto in = reverse.in_edges(u);
+        for (auto e = in.first; e != in.second; e++) {
+            func(boost::source(*e, G));
+        }
+    }
+}
+
+/**
+ * @brief Visits what start reaches over out-edges, or over in-edges when
+ * backward, through the vertices claim(v) accepts. Level-synchronous on the
+ * pool when parallel, a plain worklist on the calling thread otherwise.
+ */
+template <typename GraphType, typename ClaimFunc>
+static void _reach(const GraphType &G, const ReverseGraph<GraphType> &reverse,
+                   bool backward, bool parallel, VertIdx_t start,
+                   ClaimFunc &&claim)
+{
+    if (!parallel) {
+        std::vector<VertIdx_t> stack = {start};
+        while (!stack.empty()) {
+            VertIdx_t u = stack.back();
+            stack.pop_back();
+            _for_each_neighbour(G, reverse, backward, u, [&](VertIdx_t v) {
+                if (claim(v)) {
+                    stack.push_back(v);
+                }
+            });
+        }
+        return;
+    }
+
+    ThreadPool &pool = ThreadPool::global();
+    SparseFrontier curr_lvl;
+    std::vector<std::vector<VertIdx_t>> next_lvl(pool.concurrency());
+    auto expand = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+        for (std::size_t i = lo; i < hi; i++) {
+            _for_each_neighbour(G, reverse, backward, curr_lvl[i],
+                                [&](VertIdx_t v) {
+                                    if (claim(v)) {
+                                        next_lvl[tid].push_back(v);
+                                    }
+                                });
+        }
+    };
+    curr_lvl.push_back(start);
+    while (!curr_lvl.empty()) {
+        pool.parallel_for(0, curr_lvl.size(), EXPAND_CHUNK, expand);
+        curr_lvl.assign(pool, next_lvl);
+    }
+}
+
+/**
+ * @brief Forward-backward step: the SCC of a pivot is what it reaches both
+ * ways within its partition. The vertices reached only forward, only
+ * backward, or neither get a color each, as no SCC crosses those sets.
+ * Returns the three partitions left over, some maybe empty.
+ */
+template <typename GraphType>
+static std::array<Partition, 3>
+_split(const GraphType &G, const ReverseGraph<GraphType> &reverse,
+       Colors &colors, std::vector<VertIdx_t> &label,
+       std::atomic<std::size_t> &next_color, Partition &part, bool parallel)
+{
+    std::size_t color = part.color;
+    std::size_t fw = next_color.fetch_add(2);
+    std::size_t bw = fw + 1;
+    VertIdx_t pivot = part.verts[0];
+
+    colors[pivot].store(fw);
+    _reach(G, reverse, false, parallel, pivot, [&](VertIdx_t v) {
+        std::size_t curr = color;
+        return colors[v].compare_exchange_strong(curr, fw);
+    });
+    colors[pivot].store(DONE);
+    label[pivot] = pivot;
+    _reach(G, reverse, true, parallel, pivot, [&](VertIdx_t v) {
+        std::size_t curr = colors[v].load();
+        if (curr == fw && colors[v].compare_exchange_strong(curr, DONE)) {
+            label[v] = pivot;
+            return true;
+        }
+        return curr == color && colors[v].compare_exchange_strong(curr, bw);
+    });
+
+    std::array<Partition, 3> res = {Partition{{}, fw}, Partition{{}, bw},
+                                    Partition{{}, color}};
+    auto sort_into = [&](VertIdx_t v, std::array<Partition, 3> &parts) {
+        std::size_t curr = colors[v].load();
+        for (Partition &p : parts) {
+            if (p.color == curr) {
+                p.verts.push_back(v);
+            }
+        }
+    };
+    if (!parallel) {
+        for (VertIdx_t v : part.verts) {
+            sort_into(v, res);
+        }
+        return res;
+    }
+
+    ThreadPool &pool = ThreadPool::global();
+    std::vector<std::array<Partition, 3>> bufs(pool.concurrency(), res);
+    pool.parallel_for(0, part.verts.size(), VERT_CHUNK,
+                      [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+                          for (std::size_t i = lo; i < hi; i++) {
+                              sort_into(part.verts[i], bufs[tid]);
+                          }
+                      });
+    for (std::array<Partition, 3> &buf : bufs) {
+        for (std::size_t p = 0; p < 3; p++) {
+            res[p].verts.insert(res[p].verts.end(), buf[p].verts.begin(),
+                                buf[p].verts.end());
+        }
+    }
+    return res;
+}
+
+/**
+ * @brief Peels off vertices without in-edges or out-edges from the rest as
+ * single-vertex SCCs, repeatedly: each removal lowers the edge counts of
+ * its neighbours, and those that reach zero go next. Colors the rest 0.
+ */
+template <typename GraphType>
+static void _trim(const GraphType &G, const ReverseGraph<GraphType> &reverse,
+                  Colors &colors, std::vector<VertIdx_t> &label)
+{
+    ThreadPool &pool = ThreadPool::global();
+    std::size_t vert_cnt = boost::num_vertices(G);
+    std::vector<std::atomic<std::size_t>> edge_cnts[2] = {
+        std::vector<std::atomic<std::size_t>>(vert_cnt),
+        std::vector<std::atomic<std::size_t>>(vert_cnt)};
+    SparseFrontier curr_lvl;
+    std::vector<std::vector<VertIdx_t>> next_lvl(pool.concurrency());
+    auto claim = [&](VertIdx_t v, std::size_t tid) {
+        std::size_t curr = 0;
+        if (colors[v].compare_exchange_strong(curr, DONE)) {
+            label[v] = v;
+            next_lvl[tid].push_back(v);
+        }
+    };
+
+    pool.parallel_for(
+        0, vert_cnt, VERT_CHUNK,
+        [&](std::size_t lo, std::size_t hi, std::size_t) {
+            for (VertIdx_t v = lo; v < hi; v++) {
+                colors[v].store(0);
+                for (bool backward : {false, true}) {
+                    std::size_t cnt = 0;
+                    _for_each_neighbour(G, reverse, backward, v,
+                                        [&](VertIdx_t u) { cnt += u != v; });
+                    edge_cnts[backward][v].store(cnt);
+                }
+            }
+        });
+    pool.parallel_for(0, vert_cnt, VERT_CHUNK,
+                      [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+                          for (VertIdx_t v = lo; v < hi; v++) {
+                              if (edge_cnts[0][v] == 0 ||
+                                  edge_cnts[1][v] == 0) {
+                                  claim(v, tid);
+                              }
+                          }
+                      });
+    curr_lvl.assign(pool, next_lvl);
+
+    // Out-edges of a removed vertex lower in-edge counts, and the reverse
+    auto peel = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+        for (std::size_t i = lo; i < hi; i++) {
+            VertIdx_t v = curr_lvl[i];
+            for (bool backward : {false, true}) {
+                _for_each_neighbour(
+                    G, reverse, backward, v, [&](VertIdx_t u) {
+                        if (u != v && colors[u].load() != DONE &&
+                            edge_cnts[!backward][u].fetch_sub(1) == 1) {
+                            claim(u, tid);
+                        }
+                    });
+            }
+        }
+    };
+    while (!curr_lvl.empty()) {
+        pool.parallel_for(0, curr_lvl.size(), EXPAND_CHUNK, peel);
+        curr_lvl.assign(pool, next_lvl);
+    }
+}
+} // namespace strong
+} // namespace components
+} // namespace impl
+
+/**
+ * @brief Weakly connected components, Afforest style. Linking the first few
+ * out-edges of every vertex into a union-find forest is enough to place
+ * most of a giant component under one root, which sampling then finds. A
+ * BFS from the giant component, over in-edges as well on directed graphs,
+ * labels all of it; every other vertex then links its remaining out-edges.
+ * Every phase is a parallel loop over vertices, so the many small
+ * components keep all threads busy, and edges of the giant component are
+ * only scanned by the BFS. reverse is built for this call when it is null
+ * and G is directed.
+ */
+template <typename GraphType>
+Components
+connected_components(const GraphType &G, const BfsOptions &opts = {},
+                     const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    using namespace impl::components;
+
+    impl::ThreadPool &pool = impl::ThreadPool::global();
+    impl::ThreadPool::ScopedDispatch dispatch(pool, opts.threads, opts.wait);
+    std::size_t vert_cnt = boost::num_vertices(G);
+    Components res;
+    if (vert_cnt == 0) {
+        return res;
+    }
+
+    Parents comp(vert_cnt);
+    pool.parallel_for(0, vert_cnt, VERT_CHUNK,
+                      [&](std::size_t lo, std::size_t hi, std::size_t) {
+                          for (VertIdx_t v = lo; v < hi; v++) {
+                              comp[v].store(v, std::memory_order_relaxed);
+                          }
+                      });
+    for (std::size_t r = 0; r < NEIGHBOR_ROUNDS; r++) {
+        pool.parallel_for(
+            0, vert_cnt, VERT_CHUNK,
+            [&](std::size_t lo, std::size_t hi, std::size_t) {
+                for (VertIdx_t v = lo; v < hi; v++) {
+                    if (boost::out_degree(v, G) > r) {
+                        auto e = std::next(boost::out_edges(v, G).first, r);
+                        _link(comp, v, boost::target(*e, G));
+                    }
+                }
+            });
+        _compress(pool, comp);
+    }
+
+    std::unique_ptr<ReverseGraph<GraphType>> owned_reverse;
+    if (reverse == nullptr && boost::is_directed(G)) {
+        owned_reverse = std::make_unique<ReverseGraph<GraphType>>(G);
+        reverse = owned_reverse.get();
+    }
+    auto [giant, giant_vert] = _sample_giant(comp);
+    impl::VisitedSet visited(vert_cnt, false);
+    _weak_bfs(G, boost::is_directed(G) ? reverse : nullptr, giant_vert,
+              visited);
+
+    // Edges of unvisited vertices never lead into the giant component
+    auto finish = [&](std::size_t lo, std::size_t hi, std::size_t) {
+        for (VertIdx_t v = lo; v < hi; v++) {
+            if (visited.is_discovered(v)) {
+                comp[v].store(giant, std::memory_order_relaxed);
+                continue;
+            }
+            const auto &out = boost::out_edges(v, G);
+            auto e = std::next(out.first, std::min<std::size_t>(
+                                              boost::out_degree(v, G),
+                                              NEIGHBOR_ROUNDS));
+            for (; e != out.second; e++) {
+                _link(comp, v, boost::target(*e, G));
+            }
+        }
+    };
+    pool.parallel_for(0, vert_cnt, VERT_CHUNK, finish);
+    _compress(pool, comp);
+
+    res.label.resize(vert_cnt);
+    std::vector<std::size_t> roots(pool.concurrency());
+    pool.parallel_for(0, vert_cnt, VERT_CHUNK,
+                      [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+                          for (VertIdx_t v = lo; v < hi; v++) {
+                              res.label[v] = comp[v].load();
+                              roots[tid] += res.label[v] == v;
+                          }
+                      });
+    res.count = std::accumulate(roots.begin(), roots.end(), std::size_t(0));
+    return res;
+}
+
+/**
+ * @brief Strongly connected components with the DAG between them. Trimming
+ * first peels off the vertices that cannot lie on a cycle, most of a sparse
+ * graph. Forward-backward steps then split the rest: the vertices a pivot
+ * reaches both ways form its SCC, and the ones reached only one way or not
+ * at all form independent partitions. Large partitions are split one at a
+ * time with parallel BFS; once below PARALLEL_PART vertices, they are
+ * finished by one thread each, many at a time. reverse is built for this
+ * call when it is null.
+ */
+template <typename GraphType>
+Condensation
+strongly_connected_components(const GraphType &G, const BfsOptions &opts = {},
+                              const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    using namespace impl::components;
+    using namespace impl::components::strong;
+
+    impl::ThreadPool &pool = impl::ThreadPool::global();
+    impl::ThreadPool::ScopedDispatch dispatch(pool, opts.threads, opts.wait);
+    std::size_t vert_cnt = boost::num_vertices(G);
+    std::unique_ptr<ReverseGraph<GraphType>> owned_reverse;
+    if (reverse == nullptr) {
+        owned_reverse = std::make_unique<ReverseGraph<GraphType>>(G);
+        reverse = owned_reverse.get();
+    }
+
+    Condensation res;
+    std::vector<VertIdx_t> &label = res.components.label;
+    label.resize(vert_cnt);
+    Colors colors(vert_cnt);
+    _trim(G, *reverse, colors, label);
+
+    Partition rest{{}, 0};
+    for (VertIdx_t v = 0; v < vert_cnt; v++) {
+        if (colors[v].load() != DONE) {
+            rest.verts.push_back(v);
+        }
+    }
+    std::atomic<std::size_t> next_color(1);
+    std::vector<Partition> large = {std::move(rest)};
+    std::vector<Partition> small;
+    while (!large.empty()) {
+        Partition part = std::move(large.back());
+        large.pop_back();
+        if (part.verts.size() < PARALLEL_PART) {
+            if (!part.verts.empty()) {
+                small.push_back(std::move(part));
+            }
+            continue;
+        }
+        for (Partition &sub :
+             _split(G, *reverse, colors, label, next_color, part, true)) {
+            large.push_back(std::move(sub));
+        }
+    }
+    auto finish = [&](std::size_t lo, std::size_t hi, std::size_t) {
+        std::vector<Partition> todo(
+            std::make_move_iterator(small.begin() + lo),
+            std::make_move_iterator(small.begin() + hi));
+        while (!todo.empty()) {
+            Partition part = std::move(todo.back());
+            todo.pop_back();
+            for (Partition &sub : _split(G, *reverse, colors, label,
+                                         next_color, part, false)) {
+                if (!sub.verts.empty()) {
+                    todo.push_back(std::move(sub));
+                }
+            }
+        }
+    };
+    pool.parallel_for(0, small.size(), 1, finish);
+
+    std::vector<std::vector<std::pair<VertIdx_t, VertIdx_t>>> found(
+        pool.concurrency());
+    std::vector<std::size_t> roots(pool.concurrency());
+    pool.parallel_for(
+        0, vert_cnt, VERT_CHUNK,
+        [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+            for (VertIdx_t u = lo; u < hi; u++) {
+                roots[tid] += label[u] == u;
+                const auto &out = boost::out_edges(u, G);
+                for (auto e = out.first; e != out.second; e++) {
+                    VertIdx_t v = boost::target(*e, G);
+                    if (label[u] != label[v]) {
+                        found[tid].emplace_back(label[u], label[v]);
+                    }
+                }
+            }
+        });
+    for (auto &buf : found) {
+        res.edges.insert(res.edges.end(), buf.begin(), buf.end());
+    }
+    std::sort(res.edges.begin(), res.edges.end());
+    res.edges.erase(std::unique(res.edges.begin(), res.edges.end()),
+                    res.edges.end());
+    res.components.count =
+        std::accumulate(roots.begin(), roots.end(), std::size_t(0));
+    return res;
+}
+} // namespace parallel_bfs
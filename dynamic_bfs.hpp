@@ -0,0 +1,387 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "parallel_bfs.hpp"
+
+namespace parallel_bfs {
+namespace impl {
+namespace dynamic {
+using namespace label_correcting;
+
+// Frontier vertices per chunk of a repair round
+constexpr std::size_t REPAIR_CHUNK = 64;
+// Inserted edges per chunk when looking for seeds
+constexpr std::size_t EDGE_CHUNK = 1024;
+
+typedef std::vector<AtomicWrapper<std::uint64_t>> Labels;
+
+// Writes the label of every vertex reached by the initial traversal
+class LabelRecorder : public boost::default_bfs_visitor {
+  private:
+    Labels &_labels;
+
+  public:
+    explicit LabelRecorder(Labels &labels) : _labels(labels) {}
+
+    template <typename Edge, typename Graph>
+    void tree_edge(Edge e, const Graph &g)
+    {
+        VertIdx_t src = boost::source(e, g);
+        std::uint64_t label = _labels[src].load(std::memory_order_relaxed);
+        _labels[boost::target(e, g)].store(_pack(_depth(label) + 1, src),
+                                           std::memory_order_relaxed);
+    }
+};
+} // namespace dynamic
+} // namespace impl
+
+/**
+ * @brief Distances and BFS tree from one start vertex, kept up to date as
+ * edges are added to and removed from the graph instead of recomputed.
+ * Labels use the packed (depth, parent) format of label_correcting_bfs, so
+ * vertex indices must fit in 32 bits. The sources of every vertex's
+ * in-edges are kept as well, for finding new parents after deletions. Of
+ * the options only threads, wait and the direction-optimizing settings are
+ * used, for the initial traversal and for every update.
+ */
+template <typename GraphType> class DynamicBfs {
+  private:
+    typedef std::vector<std::pair<VertIdx_t, VertIdx_t>> EdgeList;
+    // (depth, vertex) pairs where a repair starts
+    typedef std::vector<std::pair<std::size_t, VertIdx_t>> Seeds;
+
+    const GraphType &_G;
+    VertIdx_t _start;
+    BfsOptions _opts;
+    impl::dynamic::Labels _labels;
+    std::vector<std::vector<VertIdx_t>> _preds;
+
+    // Covers vertices added to the graph since the last call
+    void _grow()
+    {
+        _labels.resize(boost::num_vertices(_G),
+                       impl::label_correcting::NO_LABEL);
+        _preds.resize(boost::num_vertices(_G));
+    }
+
+    static Seeds _merge(std::vector<Seeds> &found)
+    {
+        Seeds seeds;
+        for (Seeds &buf : found) {
+            seeds.insert(seeds.end(), buf.begin(), buf.end());
+        }
+        std::sort(seeds.begin(), seeds.end());
+        return seeds;
+    }
+
+    /**
+     * @brief Runs visit(idx, depth, next, tid) on the seeds one depth at a
+     * time from the shallowest, together with the vertices that the visits
+     * of the depth before pushed to next.
+     */
+    template <typename VisitFunc>
+    void _sweep_levels(const Seeds &seeds, VisitFunc &&visit)
+    {
+        impl::ThreadPool &pool = impl::ThreadPool::global();
+        impl::SparseFrontier curr_lvl;
+        std::vector<std::vector<VertIdx_t>> next_lvl(pool.concurrency());
+        std::size_t depth = 0;
+        auto expand = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+            for (std::size_t i = lo; i < hi; i++) {
+                visit(curr_lvl[i], depth, next_lvl[tid], tid);
+            }
+        };
+        for (std::size_t seed_i = 0;
+             !curr_lvl.empty() || seed_i < seeds.size(); depth++) {
+            if (curr_lvl.empty()) {
+                depth = seeds[seed_i].first;
+            }
+            for (; seed_i < seeds.size() && seeds[seed_i].first == depth;
+                 seed_i++) {
+                curr_lvl.push_back(seeds[seed_i].second);
+            }
+            pool.parallel_for(0, curr_lvl.size(),
+                              impl::dynamic::REPAIR_CHUNK, expand);
+            curr_lvl.assign(pool, next_lvl);
+        }
+    }
+
+    /**
+     * @brief Lowers distances out from the seeds, whose labels are already
+     * lowered. Every vertex whose distance drops is expanded once, at its
+     * final depth. Returns how many vertices were expanded.
+     */
+    std::size_t _relax_from(const Seeds &seeds)
+    {
+        using namespace impl::dynamic;
+
+        std::vector<std::size_t> changed(
+            impl::ThreadPool::global().concurrency());
+        auto relax = [&](VertIdx_t idx, std::size_t depth,
+                         std::vector<VertIdx_t> &next, std::size_t tid) {
+            // Seeds that got even closer were expanded at a lower depth
+            if (_depth(_labels[idx].load()) != depth) {
+                return;
+            }
+            changed[tid]++;
+            const auto &out = boost::out_edges(idx, _G);
+            for (auto e = out.first; e != out.second; e++) {
+                VertIdx_t adj_idx = boost::target(*e, _G);
+                std::uint64_t prev;
+                _relax(_labels[adj_idx], _pack(depth + 1, idx), &prev);
+                if (_depth(prev) > depth + 1) {
+                    next.push_back(adj_idx);
+                }
+            }
+        };
+        _sweep_levels(seeds, relax);
+        return std::accumulate(changed.begin(), changed.end(),
+                               std::size_t(0));
+    }
+
+    // Gives a dropped vertex the best label its remaining in-edges offer
+    void _seed_dropped(VertIdx_t idx, Seeds &seeds)
+    {
+        using namespace impl::dynamic;
+
+        std::uint64_t best = NO_LABEL;
+        for (VertIdx_t pred : _preds[idx]) {
+            std::uint64_t pred_label = _labels[pred].load();
+            if (pred_label != NO_LABEL) {
+                best = std::min(best, _pack(_depth(pred_label) + 1, pred));
+            }
+        }
+        if (best == NO_LABEL) {
+            return;
+        }
+        std::uint64_t prev;
+        _relax(_labels[idx], best, &prev);
+        if (_depth(prev) > _depth(best)) {
+            seeds.emplace_back(_depth(best), idx);
+        }
+    }
+
+  public:
+    DynamicBfs(const GraphType &G, VertIdx_t start, const BfsOptions &opts = {})
+        : _G(G), _start(start),
+          _labels(boost::num_vertices(G), impl::label_correcting::NO_LABEL),
+          _preds(boost::num_vertices(G))
+    {
+        _opts.threads = opts.threads;
+        _opts.wait = opts.wait;
+        _opts.direction_optimizing = opts.direction_optimizing;
+        _opts.alpha = opts.alpha;
+        _opts.beta = opts.beta;
+
+        _labels[start] = impl::label_correcting::_pack(0, start);
+        impl::dynamic::LabelRecorder recorder(_labels);
+        breadth_first_search(G, start, recorder, _opts);
+
+        impl::ThreadPool &pool = impl::ThreadPool::global();
+        impl::ThreadPool::ScopedDispatch dispatch(pool, _opts.threads,
+                                                  _opts.wait);
+        ReverseGraph<GraphType> reverse(G);
+        pool.parallel_for(0, _preds.size(), 1024,
+                          [&](std::size_t lo, std::size_t hi, std::size_t) {
+                              for (VertIdx_t v = lo; v < hi; v++) {
+                                  auto in = reverse.in_edges(v);
+                                  for (auto e = in.first; e != in.second;
+                                       e++) {
+                                      _preds[v].push_back(
+                                          boost::source(*e, G));
+                                  }
+                              }
+                          });
+    }
+
+    VertIdx_t start() const { return _start; }
+
+    // Depth of idx, UNREACHED when it cannot be reached
+    std::size_t distance(VertIdx_t idx) const
+    {
+        std::uint64_t label = _labels[idx].load(std::memory_order_relaxed);
+        if (label == impl::label_correcting::NO_LABEL) {
+            return UNREACHED;
+        }
+        return impl::label_correcting::_depth(label);
+    }
+
+    // Vertex idx was reached from, NO_PARENT when it is unreached
+    VertIdx_t parent(VertIdx_t idx) const
+    {
+        std::uint64_t label = _labels[idx].load(std::memory_order_relaxed);
+        if (label == impl::label_correcting::NO_LABEL) {
+            return NO_PARENT;
+        }
+        return impl::label_correcting::_vertex(label);
+    }
+
+    std::vector<std::size_t> distances() const
+    {
+        std::vector<std::size_t> res(_labels.size());
+        impl::ThreadPool::global().parallel_for(
+            0, res.size(), 1024,
+            [&](std::size_t lo, std::size_t hi, std::size_t) {
+                for (VertIdx_t idx = lo; idx < hi; idx++) {
+                    res[idx] = distance(idx);
+                }
+            });
+        return res;
+    }
+
+    /**
+     * @brief Updates the distances after edges were added to the graph.
+     * Endpoints that become closer seed the repair, which then relaxes out
+     * level by level from the shallowest seed, expanding each vertex whose
+     * distance dropped once, at its final depth. Work is proportional to
+     * the changed vertices and their edges. Returns how many vertices got
+     * closer.
+     */
+    std::size_t insert_edges(const EdgeList &edges)
+    {
+        using namespace impl::dynamic;
+
+        impl::ThreadPool &pool = impl::ThreadPool::global();
+        impl::ThreadPool::ScopedDispatch dispatch(pool, _opts.threads,
+                                                  _opts.wait);
+        _grow();
+        for (auto [src, dst] : edges) {
+            _preds[dst].push_back(src);
+        }
+
+        std::vector<Seeds> found(pool.concurrency());
+        auto seed = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+            for (std::size_t i = lo; i < hi; i++) {
+                auto [src, dst] = edges[i];
+                std::uint64_t label = _labels[src].load();
+                if (label == NO_LABEL) {
+                    continue;
+                }
+                std::size_t depth = _depth(label) + 1;
+                std::uint64_t prev;
+                _relax(_labels[dst], _pack(depth, src), &prev);
+                if (_depth(prev) > depth) {
+                    found[tid].emplace_back(depth, dst);
+                }
+            }
+        };
+        pool.parallel_for(0, edges.size(), EDGE_CHUNK, seed);
+        return _relax_from(_merge(found));
+    }
+
+    /**
+     * @brief Updates the distances after edges were removed from the graph,
+     * Even-Shiloach style. Vertices that lost their tree edge look for
+     * another in-neighbour one level up, level by level, so their subtree
+     * keeps its depths; only those that find none drop out and hand the
+     * search down to their tree children. The dropped vertices then take
+     * the best depth their remaining in-neighbours offer and relax out as
+     * in insert_edges. Work is proportional to the dropped vertices, the
+     * ones reattached and their edges. Returns how many vertices got
+     * further away, including those no longer reachable.
+     */
+    std::size_t remove_edges(const EdgeList &edges)
+    {
+        using namespace impl::dynamic;
+
+        impl::ThreadPool &pool = impl::ThreadPool::global();
+        impl::ThreadPool::ScopedDispatch dispatch(pool, _opts.threads,
+                                                  _opts.wait);
+        std::size_t thread_cnt = pool.concurrency();
+        _grow();
+
+        // Grouped by target so each in-edge list has a single writer
+        EdgeList by_dst(edges);
+        std::sort(by_dst.begin(), by_dst.end(),
+                  [](const auto &a, const auto &b) {
+                      return a.second < b.second;
+                  });
+        std::vector<Seeds> found(thread_cnt);
+        auto unlink = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+            std::size_t i = lo;
+            // Groups belong to the chunk holding their first edge
+            while (i > 0 && i < hi &&
+                   by_dst[i - 1].second == by_dst[i].second) {
+                i++;
+            }
+            while (i < hi) {
+                VertIdx_t dst = by_dst[i].second;
+                std::uint64_t label = _labels[dst].load();
+                bool orphaned = false;
+                for (; i < by_dst.size() && by_dst[i].second == dst; i++) {
+                    VertIdx_t src = by_dst[i].first;
+                    // remove_edge may have left parallel edges behind
+                    if (boost::edge(src, dst, _G).second) {
+                        continue;
+                    }
+                    std::vector<VertIdx_t> &preds = _preds[dst];
+                    preds.erase(std::remove(preds.begin(), preds.end(), src),
+                                preds.end());
+                    orphaned |= dst != _start && label != NO_LABEL &&
+                                _vertex(label) == src;
+                }
+                if (orphaned) {
+                    found[tid].emplace_back(_depth(label), dst);
+                }
+            }
+        };
+        pool.parallel_for(0, by_dst.size(), EDGE_CHUNK, unlink);
+
+        // Vertices that find no parent one level up lose their label
+        std::vector<std::vector<VertIdx_t>> dropped(thread_cnt);
+        auto reattach = [&](VertIdx_t idx, std::size_t depth,
+                            std::vector<VertIdx_t> &next, std::size_t tid) {
+            std::uint64_t label = _labels[idx].load();
+            if (label == NO_LABEL || _depth(label) != depth) {
+                return;
+            }
+            for (VertIdx_t pred : _preds[idx]) {
+                std::uint64_t pred_label = _labels[pred].load();
+                if (pred_label != NO_LABEL && _depth(pred_label) + 1 == depth) {
+                    _labels[idx].compare_exchange_strong(label,
+                                                         _pack(depth, pred));
+                    return;
+                }
+            }
+            // Lost to another thread handling the same vertex
+            if (!_labels[idx].compare_exchange_strong(label, NO_LABEL)) {
+                return;
+            }
+            dropped[tid].push_back(idx);
+            const auto &out = boost::out_edges(idx, _G);
+            for (auto e = out.first; e != out.second; e++) {
+                VertIdx_t adj_idx = boost::target(*e, _G);
+                if (_labels[adj_idx].load() == _pack(depth + 1, idx)) {
+                    next.push_back(adj_idx);
+                }
+            }
+        };
+        _sweep_levels(_merge(found), reattach);
+
+        for (Seeds &buf : found) {
+            buf.clear();
+        }
+        std::size_t dropped_cnt = 0;
+        for (std::vector<VertIdx_t> &buf : dropped) {
+            dropped_cnt += buf.size();
+        }
+        pool.parallel_for(0, thread_cnt, 1,
+                          [&](std::size_t lo, std::size_t hi,
+                              std::size_t tid) {
+                              for (std::size_t t = lo; t < hi; t++) {
+                                  for (VertIdx_t idx : dropped[t]) {
+                                      _seed_dropped(idx, found[tid]);
+                                  }
+                              }
+                          });
+        _relax_from(_merge(found));
+        return dropped_cnt;
+    }
+};
+} // namespace parallel_bfs
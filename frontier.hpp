@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "main.hpp"
+#include "thread_pool.hpp"
+
+namespace parallel_bfs {
+namespace impl {
+
+/**
+ * @brief Concatenates the per-thread discovery buffers into out(total), a
+ * pointer to room for all of them, and empties them, keeping their capacity.
+ * Buffer offsets come from a prefix sum over their sizes, then every output
+ * chunk is copied in parallel from the buffers it overlaps. Returns the total.
+ */
+template <typename Buffers, typename OutFunc>
+std::size_t _gather(ThreadPool &pool, Buffers &buffers,
+                    std::vector<std::size_t> &offsets,
+                    std::vector<std::size_t> &scan_scratch, OutFunc &&out)
+{
+    // Vertices copied per chunk
+    constexpr std::size_t COPY_CHUNK = 1024;
+
+    offsets.resize(buffers.size());
+    for (std::size_t b = 0; b < buffers.size(); b++) {
+        offsets[b] = buffers[b].size();
+    }
+    std::size_t total = parallel_exclusive_scan(pool, offsets, scan_scratch);
+    VertIdx_t *dst = out(total);
+
+    auto copy = [&](std::size_t lo, std::size_t hi, std::size_t) {
+        // Last buffer starting at or before lo, skipping empty ones
+        std::size_t b =
+            std::upper_bound(offsets.begin(), offsets.end(), lo) -
+            offsets.begin() - 1;
+        for (std::size_t i = lo; i < hi; b++) {
+            std::size_t end = std::min(hi, offsets[b] + buffers[b].size());
+            std::copy(buffers[b].begin() + (i - offsets[b]),
+                      buffers[b].begin() + (end - offsets[b]), dst + i);
+            i = end;
+        }
+    };
+    pool.parallel_for(0, total, COPY_CHUNK, copy);
+
+    for (auto &branch : buffers) {
+        branch.clear();
+    }
+    return total;
+}
+
+/**
+ * @brief Level frontier kept either as a vertex array (sparse) or as a bitmap
+ * over all vertices (dense). The bitmap is all zero whenever the frontier is
+ * sparse, so switching to dense only has to set the members. Both layouts are
+ * sized for every vertex up front, so no level ever allocates.
+ */
+class Frontier {
+  private:
+    // Frontiers with at least vertex count / DENSE_DIVISOR members are dense
+    static constexpr std::size_t DENSE_DIVISOR = 32;
+    // Bitmap words per chunk when scanning or converting a dense frontier
+    static constexpr std::size_t WORD_CHUNK = 16;
+
+    std::unique_ptr<VertIdx_t[]> _verts; // left uninitialised
+    AtomicBitmap _bits;
+    std::vector<std::size_t> _chunk_offsets;
+    std::vector<std::size_t> _scan_scratch;
+    std::size_t _size = 0;
+    bool _dense = false;
+
+    std::size_t _word_chunks() const
+    {
+        return (_bits.word_count() + WORD_CHUNK - 1) / WORD_CHUNK;
+    }
+
+    void _clear_bits(ThreadPool &pool)
+    {
+        pool.parallel_for(0, _bits.word_count(), WORD_CHUNK * 16,
+                          [&](std::size_t lo, std::size_t hi, std::size_t) {
+                              for (std::size_t w = lo; w < hi; w++) {
+                                  _bits.set_word(w, 0);
+                              }
+                          });
+    }
+
+  public:
+    explicit Frontier(std::size_t vert_cnt)
+        : _verts(new VertIdx_t[vert_cnt]), _bits(vert_cnt)
+    {
+    }
+
+    std::size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    bool is_dense() const { return _dense; }
+
+    // Only meaningful while dense
+    bool contains(VertIdx_t idx) const { return _bits.test(idx); }
+
+    // Only meaningful while sparse
+    VertIdx_t operator[](std::size_t i) const { return _verts[i]; }
+
+    void clear(ThreadPool &pool)
+    {
+        if (_dense) {
+            _clear_bits(pool);
+        }
+        _size = 0;
+        _dense = false;
+    }
+
+    void push_back(VertIdx_t idx)
+    {
+        if (_dense) {
+            _bits.set(idx);
+        } else {
+            _verts[_size] = idx;
+        }
+        _size++;
+    }
+
+    /**
+     * @brief Replaces the frontier with the concatenation of the per-thread
+     * discovery buffers and empties them, keeping their capacity.
+     */
+    template <typename Buffers>
+    void assign(ThreadPool &pool, Buffers &buffers)
+    {
+        clear(pool);
+        _size = _gather(pool, buffers, _chunk_offsets, _scan_scratch,
+                        [&](std::size_t) { return _verts.get(); });
+    }
+
+    /**
+     * @brief Bitmap to fill directly; commit it with assign_dense. The
+     * frontier must be cleared beforehand.
+     */
+    AtomicBitmap &bits() { return _bits; }
+
+    void assign_dense(std::size_t size)
+    {
+        _size = size;
+        _dense = true;
+    }
+
+    void to_dense(ThreadPool &pool)
+    {
+        if (_dense) {
+            return;
+        }
+        pool.parallel_for(0, _size, 256,
+                          [&](std::size_t lo, std::size_t hi, std::size_t) {
+                              for (std::size_t i = lo; i < hi; i++) {
+                                  _bits.set(_verts[i]);
+                              }
+                          });
+        _dense = true;
+    }
+
+    void to_sparse(ThreadPool &pool)
+    {
+        if (!_dense) {
+            return;
+        }
+        std::size_t chunk_cnt = _word_chunks();
+        _chunk_offsets.assign(chunk_cnt + 1, 0);
+        pool.parallel_for(
+            0, chunk_cnt, 16, [&](std::size_t lo, std::size_t hi, std::size_t) {
+                for (std::size_t c = lo; c < hi; c++) {
+                    std::size_t end = std::min((c + 1) * WORD_CHUNK,
+                                               _bits.word_count());
+                    std::size_t cnt = 0;
+                    for (std::size_t w = c * WORD_CHUNK; w < end; w++) {
+                        cnt += __builtin_popcountll(_bits.word(w));
+                    }
+                    _chunk_offsets[c + 1] = cnt;
+                }
+            });
+        for (std::size_t c = 0; c < chunk_cnt; c++) {
+            _chunk_offsets[c + 1] += _chunk_offsets[c];
+        }
+
+        pool.parallel_for(
+            0, chunk_cnt, 16, [&](std::size_t lo, std::size_t hi, std::size_t) {
+                for (std::size_t c = lo; c < hi; c++) {
+                    std::size_t end = std::min((c + 1) * WORD_CHUNK,
+                                               _bits.word_count());
+                    std::size_t pos = _chunk_offsets[c];
+                    for (std::size_t w = c * WORD_CHUNK; w < end; w++) {
+                        std::uint64_t word = _bits.word(w);
+                        while (word != 0) {
+                            _verts[pos++] = w * AtomicBitmap::WORD_BITS +
+                                            __builtin_ctzll(word);
+                            word &= word - 1;
+                        }
+                        _bits.set_word(w, 0);
+                    }
+                }
+            });
+        _dense = false;
+    }
+
+    // Picks the cheaper layout for the current size
+    void adapt(ThreadPool &pool)
+    {
+        bool want_dense = _size * DENSE_DIVISOR >= _bits.size();
+        if (want_dense) {
+            to_dense(pool);
+        } else {
+            to_sparse(pool);
+        }
+    }
+
+    /**
+     * @brief Calls func(idx, tid) for every member from the pool, in chunks
+     * of grain vertices when sparse and of bitmap words when dense.
+     */
+    template <typename Func>
+    void for_each(ThreadPool &pool, std::size_t grain, Func &&func) const
+    {
+        if (!_dense) {
+            pool.parallel_for(
+                0, _size, grain,
+                [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+                    for (std::size_t i = lo; i < hi; i++) {
+                        func(_verts[i], tid);
+                    }
+                });
+            return;
+        }
+        pool.parallel_for(
+            0, _bits.word_count(), WORD_CHUNK,
+            [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+                for (std::size_t w = lo; w < hi; w++) {
+                    std::uint64_t word = _bits.word(w);
+                    while (word != 0) {
+                        func(w * AtomicBitmap::WORD_BITS +
+                                 __builtin_ctzll(word),
+                             tid);
+                        word &= word - 1;
+                    }
+                }
+            });
+    }
+};
+
+/**
+ * @brief Vertex array frontier that only grows with the vertices it has held,
+ * for searches that should not pay for the whole graph. Offers the sparse
+ * half of the Frontier interface.
+ */
+class SparseFrontier {
+  private:
+    std::vector<VertIdx_t> _verts;
+    std::vector<std::size_t> _chunk_offsets;
+    std::vector<std::size_t> _scan_scratch;
+
+  public:
+    std::size_t size() const { return _verts.size(); }
+    bool empty() const { return _verts.empty(); }
+    VertIdx_t operator[](std::size_t i) const { return _verts[i]; }
+    const VertIdx_t *begin() const { return _verts.data(); }
+    const VertIdx_t *end() const { return _verts.data() + _verts.size(); }
+
+    void push_back(VertIdx_t idx) { _verts.push_back(idx); }
+    void to_sparse(ThreadPool &) {}
+
+    template <typename Buffers>
+    void assign(ThreadPool &pool, Buffers &buffers)
+    {
+        _gather(pool, buffers, _chunk_offsets, _scan_scratch,
+                [&](std::size_t total) {
+                    _verts.resize(total);
+                    return _verts.data();
+                });
+    }
+};
+} // namespace impl
+} // namespace parallel_bfs
@@ -5,13 +5,21 @@
 #include <queue>
 #include <random>
 #include <array>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
 
+#include <boost/graph/betweenness_centrality.hpp>
 #include <boost/graph/breadth_first_search.hpp>
+#include <boost/graph/strong_components.hpp>
 
 #include "basic_bfs.hpp"
+#include "centrality.hpp"
+#include "components.hpp"
 #include "graph_visitors.hpp"
 #include "main.hpp"
 #include "parallel_bfs.hpp"
+#include "validate_bfs.hpp"
 
 static void _generate_graph(MyGraph_t &G, std::size_t vert_count,
                             std::size_t edge_rarity, std::uint32_t seed)
@@ -68,7 +76,7 @@ typedef boost::iterator_property_map<
     boost::property_map<MyGraph_t, boost::vertex_index_t>::const_type>
     VertPMap_t;
 
-#define BFS_IMPL_CNT 8
+#define BFS_IMPL_CNT 12
 
 static std::array<BFSTimeVisitor<VertPMap_t>, BFS_IMPL_CNT>
 _init_time_visitors(MyGraph_t &G,
@@ -111,12 +119,17 @@ const std::vector<std::string> impl_names = {"boost",
                                              "2_threads",
                                              "3_threads",
                                              "4_threads",
-                                             "5_threads"};
+                                             "5_threads",
+                                             "4_threads_work_stealing",
+                                             "direction_optimizing",
+                                             "prefetching",
+                                             "label_correcting"};
 
 template <template <typename> class BFSVisitor>
 static std::array<double, BFS_IMPL_CNT>
 _test_bfs_impl(MyGraph_t &G, VertIdx_t start_idx,
-               std::array<BFSVisitor<VertPMap_t>, BFS_IMPL_CNT> &vis)
+               std::array<BFSVisitor<VertPMap_t>, BFS_IMPL_CNT> &vis,
+               std::array<std::vector<VertIdx_t>, BFS_IMPL_CNT> &vert_dist)
 {
     boost::vec_adj_list_vertex_id_map<VertData, VertIdx_t> vert_map =
         boost::get(boost::vertex_index, G);
@@ -148,24 +161,35 @@ _test_bfs_impl(MyGraph_t &G, VertIdx_t start_idx,
     deltas[idx] = timer.elapsed();
     idx++;
 
+    for (std::size_t thread_cnt = 2; thread_cnt <= 5; thread_cnt++) {
+        timer.reset();
+        parallel_bfs::breadth_first_search(G, vert_map[start_idx], vis[idx],
+                                           {.threads = thread_cnt});
+        deltas[idx] = timer.elapsed();
+        idx++;
+    }
+
     timer.reset();
-    parallel_bfs::breadth_first_search<2>(G, vert_map[start_idx], vis[idx]);
+    parallel_bfs::work_stealing_breadth_first_search<4>(
+        G, vert_map[start_idx], vis[idx]);
     deltas[idx] = timer.elapsed();
     idx++;
 
     timer.reset();
-    parallel_bfs::breadth_first_search<3>(G, vert_map[start_idx],
-                                          vis[idx]); // incorrect result
+    parallel_bfs::breadth_first_search(G, vert_map[start_idx], vis[idx],
+                                       {.direction_optimizing = true});
     deltas[idx] = timer.elapsed();
     idx++;
 
     timer.reset();
-    parallel_bfs::breadth_first_search<4>(G, vert_map[start_idx], vis[idx]);
+    parallel_bfs::breadth_first_search(G, vert_map[start_idx], vis[idx],
+                                       {.prefetch_distance = 8});
     deltas[idx] = timer.elapsed();
     idx++;
 
     timer.reset();
-    parallel_bfs::breadth_first_search<5>(G, vert_map[start_idx], vis[idx]);
+    parallel_bfs::label_correcting_bfs(
+        G, vert_map[start_idx], VertPMap_t(vert_dist[idx].begin(), vert_map));
     deltas[idx] = timer.elapsed();
     idx++;
 
@@ -192,6 +216,139 @@ _comp_test_result(const std::array<std::vector<VertIdx_t>, BFS_IMPL_CNT> &attr,
     return res;
 }
 
+// Checks a parent tree against the graph alone, without a reference run
+static void _validate_tree(MyGraph_t &G, VertIdx_t start_idx)
+{
+    std::vector<VertIdx_t> parent;
+    boost::default_bfs_visitor vis;
+    parallel_bfs::breadth_first_search(
+        G, start_idx, vis, {.direction_optimizing = true, .parent = &parent});
+    parallel_bfs::BfsTreeStatus status =
+        parallel_bfs::validate_bfs_tree(G, start_idx, parent);
+    std::cout << "tree valid: "
+              << (status == parallel_bfs::TREE_VALID ? "true" : "false")
+              << " (" << status << ")\n";
+}
+
+// Counts the vertices a per-thread traversal discovers
+class DiscoverCounter : public boost::default_bfs_visitor {
+  private:
+    std::size_t _cnt = 0;
+
+  public:
+    template <typename Vertex, typename Graph>
+    void discover_vertex(Vertex, const Graph &)
+    {
+        _cnt++;
+    }
+
+    void merge(DiscoverCounter &other)
+    {
+        _cnt += other._cnt;
+        other._cnt = 0;
+    }
+
+    std::size_t count() const { return _cnt; }
+};
+
+// Runs per-thread traversals capped at one thread inside the loop of a
+// wider dispatch, whose tids would overrun their single clone
+static void _check_nested_dispatch(MyGraph_t &G, VertIdx_t start_idx)
+{
+    auto make_counter = [](std::size_t) { return DiscoverCounter(); };
+    std::size_t expected = parallel_bfs::per_thread_breadth_first_search(
+                               G, start_idx, make_counter)
+                               .count();
+    std::atomic<std::size_t> wrong(0);
+    parallel_bfs::impl::ThreadPool &pool =
+        parallel_bfs::impl::ThreadPool::global();
+    parallel_bfs::impl::ThreadPool::ScopedDispatch dispatch(
+        pool, 4, parallel_bfs::BLOCK_WAIT);
+    pool.parallel_for(0, 64, 1, [&](std::size_t, std::size_t, std::size_t) {
+        std::size_t cnt = parallel_bfs::per_thread_breadth_first_search(
+                              G, start_idx, make_counter, {.threads = 1})
+                              .count();
+        if (cnt != expected) {
+            wrong++;
+        }
+    });
+    std::cout << "nested per-thread bfs: "
+              << (wrong == 0 ? "true" : "false") << "\n";
+}
+
+static void _print_components(MyGraph_t &G)
+{
+    parallel_bfs::Components weak = parallel_bfs::connected_components(G);
+    parallel_bfs::Condensation strong =
+        parallel_bfs::strongly_connected_components(G);
+    std::cout << "components: " << weak.count << " weak, "
+              << strong.components.count << " strong, "
+              << strong.edges.size() << " condensation edges\n";
+
+    // The partitions match when every Boost component maps to one label
+    // and the counts agree
+    std::vector<int> ref(boost::num_vertices(G));
+    std::size_t ref_cnt = boost::strong_components(
+        G, boost::make_iterator_property_map(
+               ref.begin(), boost::get(boost::vertex_index, G)));
+    bool same = strong.components.count == ref_cnt;
+    std::vector<VertIdx_t> comp_label(ref_cnt, parallel_bfs::NO_PARENT);
+    for (VertIdx_t v = 0; same && v < ref.size(); v++) {
+        VertIdx_t &label = comp_label[ref[v]];
+        if (label == parallel_bfs::NO_PARENT) {
+            label = strong.components.label[v];
+        }
+        same = label == strong.components.label[v];
+    }
+    std::cout << "strong components == boost: "
+              << (same ? "true" : "false") << "\n";
+}
+
+// Times sampled betweenness with each kind of parallelism, then checks
+// the exact scores against Boost
+static void _print_betweenness(MyGraph_t &G)
+{
+    for (bool across_sources : {false, true}) {
+        Timer timer;
+        std::vector<double> score = parallel_bfs::betweenness_centrality(
+            G, {.samples = 256, .across_sources = across_sources});
+        double elapsed = timer.elapsed();
+        auto top = std::max_element(score.begin(), score.end());
+        std::cout << "betweenness ("
+                  << (across_sources ? "across sources" : "levels")
+                  << "): " << elapsed << "s, top vertex "
+                  << top - score.begin() << "\n";
+    }
+
+    // Sums are taken in another order than Boost's, so compare up to rounding
+    std::vector<double> ref(boost::num_vertices(G));
+    boost::brandes_betweenness_centrality(
+        G, boost::make_iterator_property_map(
+               ref.begin(), boost::get(boost::vertex_index, G)));
+    std::vector<double> score = parallel_bfs::betweenness_centrality(G);
+    bool same = true;
+    for (std::size_t v = 0; same && v < ref.size(); v++) {
+        same = std::abs(score[v] - ref[v]) <=
+               1e-9 * std::max(1.0, std::abs(ref[v]));
+    }
+    std::cout << "betweenness == boost: " << (same ? "true" : "false")
+              << "\n";
+}
+
+// Times exact closeness of every vertex and the pruned top 10
+static void _print_closeness(MyGraph_t &G)
+{
+    Timer timer;
+    std::vector<double> score = parallel_bfs::closeness_centrality(G);
+    double all_elapsed = timer.elapsed();
+    timer.reset();
+    auto top = parallel_bfs::top_closeness_centrality(G, 10);
+    std::cout << "closeness: " << all_elapsed << "s for all, "
+              << timer.elapsed() << "s for the top 10, best vertex "
+              << top.front().first << " at " << score[top.front().first]
+              << "\n";
+}
+
 static void
 _print_freq(const std::array<std::vector<VertIdx_t>, BFS_IMPL_CNT> &attr)
 {
@@ -218,10 +375,12 @@ static void _run(MyGraph_t &G, std::vector<std::string> labels,
     vert_dist.fill(std::vector<VertIdx_t>(boost::num_vertices(G)));
     auto dist_vistors = _init_dist_visitors(G, vert_dist);
     auto impl_time_on_dist =
-        _test_bfs_impl<BFSDistVisitor>(G, start_idx, dist_vistors);
+        _test_bfs_impl<BFSDistVisitor>(G, start_idx, dist_vistors, vert_dist);
     auto dist_freq = get_freq_map(vert_dist[0]);
     auto dist_res_cmp = _comp_test_result(vert_dist, "dist");
     _print_freq(vert_dist);
+    _validate_tree(G, start_idx);
+    _check_nested_dispatch(G, start_idx);
 
     std::ofstream csv;
     std::string path;
@@ -329,6 +488,7 @@ int main()
     constexpr std::array<std::size_t, EDGE_RARITY_N> edge_rarities = {
         1, 5, 10, 15, 20, 30, 50, 100, 200};
     constexpr auto rest_times = calc_rest_times(vert_counts, edge_rarities);
+    parallel_bfs::enable_numa();
 
     std::string output_dir = "output/";
     std::filesystem::create_directory(output_dir);
@@ -367,10 +527,13 @@ int main()
     }
     {
         MyGraph_t G;
-        std::size_t vert_count = 7115;
+        // Ids run up to 8297 with gaps, 7115 of them used
+        std::size_t vert_count = 8298;
         std::string file_prefix = output_dir + "wiki-Vote_";
         add_csv_header({}, file_prefix);
-        _load_graph<DIRECTED>(G, vert_count, data_dir + "wiki-Vote.txt", " ");
+        _load_graph<DIRECTED>(G, vert_count, data_dir + "Wiki-Vote.txt", " ");
+        _print_components(G);
+        _print_betweenness(G);
         std::vector<std::string> labels(0);
         for (int id = START_I; id <= END_I; id++) {
             _run(G, labels, file_prefix);
@@ -384,6 +547,7 @@ int main()
         add_csv_header({}, file_prefix);
         _load_graph<UNDIRECTED>(G, vert_count,
                                 data_dir + "musae_facebook_edges.csv", ",");
+        _print_closeness(G);
         std::vector<std::string> labels(0);
         for (int id = START_I; id <= END_I; id++) {
             _run(G, labels, file_prefix);
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "parallel_bfs.hpp"
+
+namespace parallel_bfs {
+
+/**
+ * @brief One bit per source of a multi-source batch, 64 * WORDS sources wide.
+ * Word-wise operators let the compiler vectorise wider masks.
+ */
+template <std::size_t WORDS> struct SourceMask {
+    std::array<std::uint64_t, WORDS> words{};
+
+    static constexpr std::size_t BITS = 64 * WORDS;
+
+    SourceMask &operator|=(const SourceMask &other)
+    {
+        for (std::size_t w = 0; w < WORDS; w++) {
+            words[w] |= other.words[w];
+        }
+        return *this;
+    }
+
+    SourceMask &operator&=(const SourceMask &other)
+    {
+        for (std::size_t w = 0; w < WORDS; w++) {
+            words[w] &= other.words[w];
+        }
+        return *this;
+    }
+
+    // this & ~other
+    SourceMask without(const SourceMask &other) const
+    {
+        SourceMask res;
+        for (std::size_t w = 0; w < WORDS; w++) {
+            res.words[w] = words[w] & ~other.words[w];
+        }
+        return res;
+    }
+
+    bool any() const
+    {
+        std::uint64_t acc = 0;
+        for (std::size_t w = 0; w < WORDS; w++) {
+            acc |= words[w];
+        }
+        return acc != 0;
+    }
+
+    bool covers(const SourceMask &other) const
+    {
+        return !other.without(*this).any();
+    }
+
+    void set(std::size_t bit)
+    {
+        words[bit / 64] |= std::uint64_t(1) << (bit % 64);
+    }
+
+    // Calls func(bit) for every set bit, in increasing order
+    template <typename Func> void for_each_bit(Func &&func) const
+    {
+        for (std::size_t w = 0; w < WORDS; w++) {
+            std::uint64_t word = words[w];
+            while (word != 0) {
+                func(w * 64 + __builtin_ctzll(word));
+                word &= word - 1;
+            }
+        }
+    }
+};
+
+namespace impl {
+namespace multi_source {
+// Vertices per chunk of a level sweep
+constexpr std::size_t SWEEP_CHUNK = 256;
+
+/**
+ * @brief Advances up to SourceMask<WORDS>::BITS traversals together. On every
+ * level each vertex ORs the visit masks of its in-neighbours, so one pass over
+ * an adjacency list serves every source of the batch at once. Vertices
+ * already reached by the whole batch are skipped. When on_level returns a
+ * mask, the sources set in it are no longer followed.
+ */
+template <std::size_t WORDS, typename GraphType, typename DiscoverFunc,
+          typename LevelFunc>
+void _run_batch(const GraphType &G, const ReverseGraph<GraphType> &reverse,
+                const VertIdx_t *sources, std::size_t source_cnt,
+                DiscoverFunc &on_discover, LevelFunc &on_level)
+{
+    typedef SourceMask<WORDS> Mask;
+
+    ThreadPool &pool = ThreadPool::global();
+    std::size_t vert_cnt = boost::num_vertices(G);
+    std::vector<Mask> seen(vert_cnt);
+    std::vector<Mask> visit(vert_cnt);
+    std::vector<Mask> visit_next(vert_cnt);
+    std::vector<char> progressed(pool.concurrency());
+
+    Mask batch;
+    for (std::size_t i = 0; i < source_cnt; i++) {
+        batch.set(i);
+        seen[sources[i]].set(i);
+        visit[sources[i]].set(i);
+    }
+    for (std::size_t i = 0; i < source_cnt; i++) {
+        // Report a root listed several times only once
+        if (std::find(sources, sources + i, sources[i]) == sources + i) {
+            on_discover(sources[i], visit[sources[i]], 0, 0);
+        }
+    }
+    // Drops the sources on_level stops, returns whether any are left
+    auto end_level = [&](std::size_t depth) {
+        if constexpr (std::is_void_v<decltype(on_level(depth))>) {
+            on_level(depth);
+        } else {
+            batch = batch.without(on_level(depth));
+        }
+        return batch.any();
+    };
+    if (!end_level(0)) {
+        return;
+    }
+
+    auto sweep = [&](std::size_t lo, std::size_t hi, std::size_t tid,
+                     std::size_t depth) {
+        for (VertIdx_t v = lo; v < hi; v++) {
+            if (seen[v].covers(batch)) {
+                visit_next[v] = Mask();
+                continue;
+            }
+            Mask reached;
+            auto edges = reverse.in_edges(v);
+            for (auto i = edges.first; i != edges.second; i++) {
+                reached |= visit[boost::source(*i, G)];
+            }
+            reached = reached.without(seen[v]);
+            reached &= batch;
+            visit_next[v] = reached;
+            if (reached.any()) {
+                seen[v] |= reached;
+                on_discover(v, reached, depth, tid);
+                progressed[tid] = true;
+            }
+        }
+    };
+
+    for (std::size_t depth = 1;; depth++) {
+        std::fill(progressed.begin(), progressed.end(), false);
+        pool.parallel_for(
+            0, vert_cnt, SWEEP_CHUNK,
+            [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+                sweep(lo, hi, tid, depth);
+            });
+        std::swap(visit, visit_next);
+        if (std::find(progressed.begin(), progressed.end(), true) ==
+            progressed.end()) {
+            break;
+        }
+        if (!end_level(depth)) {
+            break;
+        }
+    }
+}
+} // namespace multi_source
+} // namespace impl
+
+/**
+ * @brief Runs BFS from every vertex in sources at once, 64 * WORDS sources
+ * per sweep. on_discover(batch_begin, v, mask, depth, tid) is called from
+ * pool threads once per vertex and level, where bit i of mask stands for
+ * sources[batch_begin + i]. on_level(batch_begin, depth) is then called from
+ * the calling thread once every vertex of that level has been reported,
+ * which is where per-thread state can be merged. on_level may return a
+ * SourceMask of the batch's sources to stop following. reverse is built for
+ * this call when null.
+ */
+template <std::size_t WORDS = 1, typename GraphType, typename DiscoverFunc,
+          typename LevelFunc>
+void multi_source_bfs(const GraphType &G,
+                      const std::vector<VertIdx_t> &sources,
+                      DiscoverFunc on_discover, LevelFunc on_level,
+                      const BfsOptions &opts = {},
+                      const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    constexpr std::size_t BATCH = SourceMask<WORDS>::BITS;
+
+    impl::ThreadPool::ScopedDispatch dispatch(impl::ThreadPool::global(),
+                                              opts.threads, opts.wait);
+    std::unique_ptr<ReverseGraph<GraphType>> owned_reverse;
+    if (reverse == nullptr) {
+        owned_reverse = std::make_unique<ReverseGraph<GraphType>>(G);
+        reverse = owned_reverse.get();
+    }
+
+    for (std::size_t begin = 0; begin < sources.size(); begin += BATCH) {
+        std::size_t cnt = std::min(BATCH, sources.size() - begin);
+        auto discover = [&](VertIdx_t v, const SourceMask<WORDS> &mask,
+                            std::size_t depth, std::size_t tid) {
+            on_discover(begin, v, mask, depth, tid);
+        };
+        auto level = [&](std::size_t depth) {
+            return on_level(begin, depth);
+        };
+        impl::multi_source::_run_batch<WORDS>(G, *reverse,
+                                              sources.data() + begin, cnt,
+                                              discover, level);
+    }
+}
+
+/**
+ * @brief Distance from sources[i] to every vertex, UNREACHED where there is
+ * no path.
+ */
+template <std::size_t WORDS = 1, typename GraphType>
+std::vector<std::vector<std::size_t>>
+multi_source_distances(const GraphType &G,
+                       const std::vector<VertIdx_t> &sources,
+                       const BfsOptions &opts = {},
+                       const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    std::vector<std::vector<std::size_t>> dist(
+        sources.size(),
+        std::vector<std::size_t>(boost::num_vertices(G), UNREACHED));
+    multi_source_bfs<WORDS>(
+        G, sources,
+        [&](std::size_t begin, VertIdx_t v, const SourceMask<WORDS> &mask,
+            std::size_t depth, std::size_t) {
+            mask.for_each_bit(
+                [&](std::size_t i) { dist[begin + i][v] = depth; });
+        },
+        [](std::size_t, std::size_t) {}, opts, reverse);
+    return dist;
+}
+
+/**
+ * @brief hist[i][d] is the number of vertices at distance d from sources[i].
+ */
+template <std::size_t WORDS = 1, typename GraphType>
+std::vector<std::vector<std::size_t>>
+multi_source_level_histograms(const GraphType &G,
+                              const std::vector<VertIdx_t> &sources,
+                              const BfsOptions &opts = {},
+                              const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    constexpr std::size_t BATCH = SourceMask<WORDS>::BITS;
+
+    // Fixes the cap level_cnts is sized from; the dispatch of
+    // multi_source_bfs keeps it even if the pool grows meanwhile
+    impl::ThreadPool &pool = impl::ThreadPool::global();
+    impl::ThreadPool::ScopedDispatch dispatch(pool, opts.threads, opts.wait);
+    std::vector<std::vector<std::size_t>> hist(sources.size());
+    // Per-thread counts of the current level, merged by on_level
+    std::vector<std::array<std::size_t, BATCH>> level_cnts(
+        pool.concurrency());
+    multi_source_bfs<WORDS>(
+        G, sources,
+        [&](std::size_t, VertIdx_t, const SourceMask<WORDS> &mask,
+            std::size_t, std::size_t tid) {
+            mask.for_each_bit([&](std::size_t i) { level_cnts[tid][i]++; });
+        },
+        [&](std::size_t begin, std::size_t depth) {
+            std::size_t cnt = std::min(BATCH, sources.size() - begin);
+            for (std::size_t i = 0; i < cnt; i++) {
+                std::size_t sum = 0;
+                for (auto &cnts : level_cnts) {
+                    sum += cnts[i];
+                    cnts[i] = 0;
+                }
+                if (sum > 0) {
+                    hist[begin + i].resize(depth + 1, 0);
+                    hist[begin + i][depth] = sum;
+                }
+            }
+        },
+        opts, reverse);
+    return hist;
+}
+} // namespace parallel_bfs
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace parallel_bfs {
+
+/**
+ * @brief CPUs of every NUMA node this process may run on. Read from sysfs on
+ * Linux; machines without that information, or where only one node is
+ * usable, come out as a single node holding every allowed CPU.
+ */
+class NumaTopology {
+  private:
+    std::vector<std::vector<unsigned>> _node_cpus;
+    std::vector<std::size_t> _cpu_nodes; // indexed by CPU
+
+    // Parses a sysfs cpulist such as "0-3,8-11"
+    static std::vector<unsigned> _parse_cpu_list(const std::string &list)
+    {
+        std::vector<unsigned> cpus;
+        std::size_t pos = 0;
+        while (pos < list.size()) {
+            std::size_t end = list.find(',', pos);
+            if (end == std::string::npos) {
+                end = list.size();
+            }
+            unsigned first = 0;
+            unsigned last = 0;
+            int read = sscanf(list.c_str() + pos, "%u-%u", &first, &last);
+            if (read == 1) {
+                last = first;
+            }
+            for (unsigned cpu = first; read > 0 && cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+            pos = end + 1;
+        }
+        return cpus;
+    }
+
+    static std::vector<unsigned> _allowed_cpus()
+    {
+        std::vector<unsigned> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &set)) {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+        if (cpus.empty()) {
+            for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency();
+                 cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+  public:
+    explicit NumaTopology(std::vector<std::vector<unsigned>> node_cpus)
+        : _node_cpus(std::move(node_cpus))
+    {
+        if (_node_cpus.empty()) {
+            _node_cpus.emplace_back();
+        }
+        for (std::size_t node = 0; node < _node_cpus.size(); node++) {
+            for (unsigned cpu : _node_cpus[node]) {
+                _cpu_nodes.resize(std::max<std::size_t>(_cpu_nodes.size(),
+                                                        cpu + 1),
+                                  0);
+                _cpu_nodes[cpu] = node;
+            }
+        }
+    }
+
+    static NumaTopology detect()
+    {
+        std::vector<unsigned> allowed = _allowed_cpus();
+        std::vector<std::vector<unsigned>> node_cpus;
+        for (std::size_t node = 0;; node++) {
+            std::ifstream file("/sys/devices/system/node/node" +
+                               std::to_string(node) + "/cpulist");
+            std::string list;
+            if (!std::getline(file, list)) {
+                break;
+            }
+            std::vector<unsigned> cpus;
+            for (unsigned cpu : _parse_cpu_list(list)) {
+                if (std::find(allowed.begin(), allowed.end(), cpu) !=
+                    allowed.end()) {
+                    cpus.push_back(cpu);
+                }
+            }
+            // Nodes without usable CPUs would never run their share
+            if (!cpus.empty()) {
+                node_cpus.push_back(cpus);
+            }
+        }
+        if (node_cpus.empty()) {
+            node_cpus.push_back(allowed);
+        }
+        return NumaTopology(node_cpus);
+    }
+
+    /**
+     * @brief Deals the allowed CPUs out to node_cnt pretend nodes, so the
+     * multi-node code paths can be exercised on single-node machines.
+     */
+    static NumaTopology emulate(std::size_t node_cnt)
+    {
+        std::vector<unsigned> allowed = _allowed_cpus();
+        std::vector<std::vector<unsigned>> node_cpus(
+            std::max<std::size_t>(node_cnt, 1));
+        for (std::size_t i = 0; i < allowed.size(); i++) {
+            node_cpus[i * node_cpus.size() / allowed.size()].push_back(
+                allowed[i]);
+        }
+        return NumaTopology(node_cpus);
+    }
+
+    static const NumaTopology &system()
+    {
+        static const NumaTopology topology = detect();
+        return topology;
+    }
+
+    std::size_t node_count() const { return _node_cpus.size(); }
+
+    const std::vector<unsigned> &cpus(std::size_t node) const
+    {
+        return _node_cpus[node];
+    }
+
+    // Node of cpu, 0 for CPUs the topology does not know
+    std::size_t node_of_cpu(unsigned cpu) const
+    {
+        return (cpu < _cpu_nodes.size()) ? _cpu_nodes[cpu] : 0;
+    }
+
+    /**
+     * @brief Restricts thread to the CPUs of node. Returns false, leaving
+     * the thread where it was, when the system refuses.
+     */
+    bool pin(pthread_t thread, std::size_t node) const
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned cpu : _node_cpus[node]) {
+            CPU_SET(cpu, &set);
+        }
+        return !_node_cpus[node].empty() &&
+               pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+    }
+};
+} // namespace parallel_bfs
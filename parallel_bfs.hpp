@@ -1,17 +1,146 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <list>
+#include <memory>
+#include <numeric>
 #include <thread>
 #include <vector>
 
+#include <boost/graph/breadth_first_search.hpp>
+#include <boost/lockfree/queue.hpp>
+
+#include "bitmap.hpp"
+#include "frontier.hpp"
 #include "main.hpp"
+#include "reverse_graph.hpp"
+#include "thread_pool.hpp"
+#include "visitor_traits.hpp"
 
 namespace parallel_bfs {
+
+// Depth reported for vertices that cannot be reached
+constexpr std::size_t UNREACHED = ~std::size_t(0);
+// Parent recorded for vertices that cannot be reached
+constexpr VertIdx_t NO_PARENT = ~VertIdx_t(0);
+
+/**
+ * @brief Cooperative cancellation of traversals run through BfsOptions:
+ * cancel() may be called from any thread, and the workers stop at their next
+ * chunk.
+ */
+class CancelToken {
+  private:
+    std::atomic<bool> _cancelled{false};
+
+  public:
+    void cancel() { _cancelled.store(true, std::memory_order_relaxed); }
+    bool cancelled() const
+    {
+        return _cancelled.load(std::memory_order_relaxed);
+    }
+};
+
+struct BfsOptions {
+    // Threads taking part in each level, 0 keeps the enclosing dispatch's
+    // cap, the whole shared pool at top level
+    std::size_t threads = 0;
+    // How the calling thread waits for the others at level boundaries
+    WaitStrategy wait = BLOCK_WAIT;
+    // Pull from unvisited vertices on levels with large frontiers
+    bool direction_optimizing = false;
+    // Go bottom-up once frontier out-edges exceed unexplored edges / alpha
+    double alpha = 15.0;
+    // Go back top-down once the frontier holds fewer than vertices / beta
+    double beta = 18.0;
+    // When set, resized to the vertex count and filled with the BFS tree:
+    // the discovering vertex of every reached vertex, start for start itself
+    // and NO_PARENT for unreached vertices
+    std::vector<VertIdx_t> *parent = nullptr;
+    // Vertices this many levels from start are discovered but not expanded;
+    // UNREACHED for no limit. Bounded searches always go top-down and only
+    // touch the vertices they reach
+    std::size_t max_depth = UNREACHED;
+    // Top-down levels prefetch the visited marks of targets this many edges
+    // ahead, after prefetching the records and adjacencies of a whole chunk
+    // of frontier vertices; 0 turns prefetching off
+    std::size_t prefetch_distance = 0;
+    // Once cancelled, the traversal stops at the next chunk and is partial
+    const CancelToken *cancel = nullptr;
+    // Past this time, the traversal stops at the next chunk and is partial
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::time_point::max();
+};
+
+// How a traversal run through BfsOptions ended
+struct BfsOutcome {
+    // False when opts.cancel or opts.deadline stopped it early
+    bool complete = true;
+    // Every vertex up to this many levels from start was discovered. When
+    // stopped, the visitor may also have seen part of the next level, but
+    // no event of later levels and no end_level for the partial one
+    std::size_t depth = 0;
+};
+
 namespace impl {
 
 enum VertColor { WHITE, GRAY, BLACK };
 
+/**
+ * @brief Cancel token and deadline of one traversal, polled by the workers
+ * once per chunk. The first poll that finds either fired latches the stop,
+ * after which every chunk is skipped.
+ */
+class StopSignal {
+  private:
+    const CancelToken *_token;
+    std::chrono::steady_clock::time_point _deadline;
+    std::atomic<bool> _stopped{false};
+
+  public:
+    explicit StopSignal(const BfsOptions &opts)
+        : _token(opts.cancel), _deadline(opts.deadline)
+    {
+    }
+
+    // Whether there is anything to poll for
+    bool armed() const
+    {
+        return _token != nullptr ||
+               _deadline != std::chrono::steady_clock::time_point::max();
+    }
+
+    bool poll()
+    {
+        if (stopped()) {
+            return true;
+        }
+        if ((_token != nullptr && _token->cancelled()) ||
+            std::chrono::steady_clock::now() >= _deadline) {
+            _stopped.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    bool stopped() const { return _stopped.load(std::memory_order_relaxed); }
+};
+
+// Whether the chunk about to run should be skipped; stop may be null
+inline bool _should_stop(StopSignal *stop)
+{
+    return stop != nullptr && stop->poll();
+}
+
+// Whether the last level was cut short; stop may be null
+inline bool _stopped(const StopSignal *stop)
+{
+    return stop != nullptr && stop->stopped();
+}
+
 struct ThreadData {
     VertIdx_t idx;
     std::list<VertIdx_t> adj_list;
@@ -36,85 +165,648 @@ template <typename T> class AtomicWrapper : public std::atomic<T> {
         return *this;
     }
 };
+
+/**
+ * @brief Discovered and finished bits per vertex. VertColor is only derived
+ * on demand, for the gray/black split of non-tree edges; sets built without
+ * finished bits must never be finished or asked about them.
+ */
+class VisitedSet {
+  private:
+    AtomicBitmap _discovered;
+    AtomicBitmap _finished;
+
+  public:
+    explicit VisitedSet(std::size_t vert_cnt, bool track_finished = true)
+        : _discovered(vert_cnt), _finished(track_finished ? vert_cnt : 0)
+    {
+    }
+
+    bool try_discover(VertIdx_t idx) { return _discovered.test_and_set(idx); }
+    void discover(VertIdx_t idx) { _discovered.set(idx); }
+    bool is_discovered(VertIdx_t idx) const { return _discovered.test(idx); }
+    void prefetch(VertIdx_t idx) const { _discovered.prefetch(idx); }
+
+    void finish(VertIdx_t idx) { _finished.set(idx); }
+    bool is_finished(VertIdx_t idx) const { return _finished.test(idx); }
+
+    VertColor color(VertIdx_t idx) const
+    {
+        if (!is_discovered(idx)) {
+            return WHITE;
+        }
+        return is_finished(idx) ? BLACK : GRAY;
+    }
+};
+
+/**
+ * @brief Epoch-stamped discovered and finished marks. The stamp array is kept
+ * per calling thread and reused by every search that thread makes, so a
+ * search only pays for the vertices it touches: starting one just moves to a
+ * new epoch, which turns every older stamp white. A thread can only run one
+ * such search at a time.
+ */
+class EpochVisitedSet {
+  private:
+    struct Stamps {
+        std::vector<std::atomic<std::uint32_t>> marks;
+        std::uint32_t epoch = 0;
+    };
+
+    // Gray is 2 * epoch and black 2 * epoch + 1, so the epoch stops short
+    static constexpr std::uint32_t MAX_EPOCH = ~std::uint32_t(0) / 2 - 1;
+
+    std::atomic<std::uint32_t> *_marks;
+    std::uint32_t _gray;
+    std::uint32_t _black;
+
+    static Stamps &_stamps()
+    {
+        static thread_local Stamps stamps;
+        return stamps;
+    }
+
+  public:
+    explicit EpochVisitedSet(std::size_t vert_cnt)
+    {
+        Stamps &stamps = _stamps();
+        if (stamps.marks.size() < vert_cnt || stamps.epoch == MAX_EPOCH) {
+            stamps.marks = std::vector<std::atomic<std::uint32_t>>(
+                std::max(vert_cnt, stamps.marks.size()));
+            stamps.epoch = 0;
+        }
+        stamps.epoch++;
+        _marks = stamps.marks.data();
+        _gray = 2 * stamps.epoch;
+        _black = _gray + 1;
+    }
+
+    bool try_discover(VertIdx_t idx)
+    {
+        std::uint32_t mark = _marks[idx].load(std::memory_order_relaxed);
+        // Any failed exchange means another thread stamped this epoch
+        return mark < _gray &&
+               _marks[idx].compare_exchange_strong(mark, _gray,
+                                                   std::memory_order_relaxed);
+    }
+
+    void discover(VertIdx_t idx)
+    {
+        _marks[idx].store(_gray, std::memory_order_relaxed);
+    }
+
+    bool is_discovered(VertIdx_t idx) const
+    {
+        return _marks[idx].load(std::memory_order_relaxed) >= _gray;
+    }
+
+    void prefetch(VertIdx_t idx) const { __builtin_prefetch(&_marks[idx], 1); }
+
+    void finish(VertIdx_t idx)
+    {
+        _marks[idx].store(_black, std::memory_order_relaxed);
+    }
+
+    bool is_finished(VertIdx_t idx) const
+    {
+        return _marks[idx].load(std::memory_order_relaxed) == _black;
+    }
+};
+
+/**
+ * @brief Forwards every event to visitor; adaptors hide the events they
+ * extend.
+ */
+template <typename VisitorType> class ForwardingVisitor {
+  protected:
+    VisitorType &_visitor;
+
+  public:
+    explicit ForwardingVisitor(VisitorType &visitor) : _visitor(visitor) {}
+
+    template <typename Vertex, typename Graph>
+    void initialize_vertex(Vertex u, const Graph &g)
+    {
+        _visitor.initialize_vertex(u, g);
+    }
+    template <typename Vertex, typename Graph>
+    void discover_vertex(Vertex u, const Graph &g)
+    {
+        _visitor.discover_vertex(u, g);
+    }
+    template <typename Vertex, typename Graph>
+    void examine_vertex(Vertex u, const Graph &g)
+    {
+        _visitor.examine_vertex(u, g);
+    }
+    template <typename Edge, typename Graph>
+    void examine_edge(Edge e, const Graph &g)
+    {
+        _visitor.examine_edge(e, g);
+    }
+    template <typename Edge, typename Graph>
+    void tree_edge(Edge e, const Graph &g)
+    {
+        _visitor.tree_edge(e, g);
+    }
+    template <typename Edge, typename Graph>
+    void non_tree_edge(Edge e, const Graph &g)
+    {
+        _visitor.non_tree_edge(e, g);
+    }
+    template <typename Edge, typename Graph>
+    void gray_target(Edge e, const Graph &g)
+    {
+        _visitor.gray_target(e, g);
+    }
+    template <typename Edge, typename Graph>
+    void black_target(Edge e, const Graph &g)
+    {
+        _visitor.black_target(e, g);
+    }
+    template <typename Vertex, typename Graph>
+    void finish_vertex(Vertex u, const Graph &g)
+    {
+        _visitor.finish_vertex(u, g);
+    }
+    void end_level() { _end_level(_visitor); }
+};
+
+/**
+ * @brief One visitor per pool thread, each event going to the clone of the
+ * thread raising it, so events never contend. At the end of every level the
+ * clones are merged into the first one in thread order, when the visitor
+ * type has merge(VisitorType &other), before its own end_level runs.
+ */
+template <typename VisitorType> class ThreadVisitors {
+  private:
+    std::vector<VisitorType> _clones;
+
+    VisitorType &_local() { return _clones[ThreadPool::current_tid()]; }
+
+  public:
+    template <typename Factory>
+    ThreadVisitors(std::size_t thread_cnt, Factory &make_visitor)
+    {
+        _clones.reserve(thread_cnt);
+        for (std::size_t tid = 0; tid < thread_cnt; tid++) {
+            _clones.push_back(make_visitor(tid));
+        }
+    }
+
+    // The first clone, holding every merged result
+    VisitorType &merged() { return _clones[0]; }
+
+    template <typename Vertex, typename Graph>
+    void initialize_vertex(Vertex u, const Graph &g)
+    {
+        _local().initialize_vertex(u, g);
+    }
+    template <typename Vertex, typename Graph>
+    void discover_vertex(Vertex u, const Graph &g)
+    {
+        _local().discover_vertex(u, g);
+    }
+    template <typename Vertex, typename Graph>
+    void examine_vertex(Vertex u, const Graph &g)
+    {
+        _local().examine_vertex(u, g);
+    }
+    template <typename Edge, typename Graph>
+    void examine_edge(Edge e, const Graph &g)
+    {
+        _local().examine_edge(e, g);
+    }
+    template <typename Edge, typename Graph>
+    void tree_edge(Edge e, const Graph &g)
+    {
+        _local().tree_edge(e, g);
+    }
+    template <typename Edge, typename Graph>
+    void non_tree_edge(Edge e, const Graph &g)
+    {
+        _local().non_tree_edge(e, g);
+    }
+    template <typename Edge, typename Graph>
+    void gray_target(Edge e, const Graph &g)
+    {
+        _local().gray_target(e, g);
+    }
+    template <typename Edge, typename Graph>
+    void black_target(Edge e, const Graph &g)
+    {
+        _local().black_target(e, g);
+    }
+    template <typename Vertex, typename Graph>
+    void finish_vertex(Vertex u, const Graph &g)
+    {
+        _local().finish_vertex(u, g);
+    }
+
+    void merge_clones()
+    {
+        if constexpr (HasMerge<VisitorType>::value) {
+            for (std::size_t tid = 1; tid < _clones.size(); tid++) {
+                _clones[0].merge(_clones[tid]);
+            }
+        }
+    }
+
+    void end_level()
+    {
+        merge_clones();
+        _end_level(_clones[0]);
+    }
+};
+
+/**
+ * @brief Records the source of each tree edge as the parent of its target.
+ * Every vertex has exactly one tree edge, so the parent writes never race.
+ */
+template <typename VisitorType>
+class ParentRecorder : public ForwardingVisitor<VisitorType> {
+  private:
+    std::vector<VertIdx_t> &_parent;
+
+  public:
+    ParentRecorder(VisitorType &visitor, std::vector<VertIdx_t> &parent)
+        : ForwardingVisitor<VisitorType>(visitor), _parent(parent)
+    {
+    }
+
+    template <typename Edge, typename Graph>
+    void tree_edge(Edge e, const Graph &g)
+    {
+        _parent[boost::target(e, g)] = boost::source(e, g);
+        this->_visitor.tree_edge(e, g);
+    }
+};
+
+/**
+ * @brief Initialises vertices as their tree edge reaches them instead of all
+ * up front, for searches that must not touch every vertex. The start vertex
+ * is initialised by the engine.
+ */
+template <typename VisitorType>
+class LazyInitVisitor : public ForwardingVisitor<VisitorType> {
+  public:
+    using ForwardingVisitor<VisitorType>::ForwardingVisitor;
+
+    template <typename Edge, typename Graph>
+    void tree_edge(Edge e, const Graph &g)
+    {
+        this->_visitor.initialize_vertex(boost::target(e, g), g);
+        this->_visitor.tree_edge(e, g);
+    }
+};
+
+// Adaptors only add to the events of the visitor they wrap
+template <typename VisitorType, typename GraphType>
+struct EventUse<ForwardingVisitor<VisitorType>, GraphType>
+    : EventUse<VisitorType, GraphType> {};
+
+template <typename VisitorType, typename GraphType>
+struct EventUse<ParentRecorder<VisitorType>, GraphType>
+    : EventUse<VisitorType, GraphType> {
+    static constexpr bool tree_edge = true;
+};
+
+template <typename VisitorType, typename GraphType>
+struct EventUse<LazyInitVisitor<VisitorType>, GraphType>
+    : EventUse<VisitorType, GraphType> {
+    static constexpr bool tree_edge =
+        EventUse<VisitorType, GraphType>::tree_edge ||
+        EventUse<VisitorType, GraphType>::initialize_vertex;
+};
+
+template <typename VisitorType, typename GraphType>
+struct EventUse<ThreadVisitors<VisitorType>, GraphType>
+    : EventUse<VisitorType, GraphType> {};
+
+/**
+ * @brief Fixed-capacity Chase-Lev deque of packed [lo, hi) index ranges. The
+ * owning worker pushes and pops at the bottom, thieves steal from the top.
+ */
+class ChaseLevDeque {
+  private:
+    static constexpr std::int64_t CAPACITY = 64;
+
+    std::atomic<std::int64_t> _top{0};
+    std::atomic<std::int64_t> _bottom{0};
+    std::array<std::atomic<std::uint64_t>, CAPACITY> _buf;
+
+  public:
+    static std::uint64_t pack(std::size_t lo, std::size_t hi)
+    {
+        return (static_cast<std::uint64_t>(lo) << 32) |
+               static_cast<std::uint32_t>(hi);
+    }
+
+    static void unpack(std::uint64_t range, std::size_t &lo, std::size_t &hi)
+    {
+        lo = range >> 32;
+        hi = static_cast<std::uint32_t>(range);
+    }
+
+    // Only valid while no other thread touches the deque
+    void reset()
+    {
+        _top.store(0, std::memory_order_relaxed);
+        _bottom.store(0, std::memory_order_relaxed);
+    }
+
+    bool push(std::uint64_t range)
+    {
+        std::int64_t b = _bottom.load(std::memory_order_relaxed);
+        std::int64_t t = _top.load(std::memory_order_acquire);
+        if (b - t >= CAPACITY) {
+            return false;
+        }
+        _buf[b % CAPACITY].store(range, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool pop(std::uint64_t &range)
+    {
+        std::int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = _top.load(std::memory_order_relaxed);
+        if (t > b) { // empty
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        range = _buf[b % CAPACITY].load(std::memory_order_relaxed);
+        if (t < b) {
+            return true;
+        }
+        // Last element, race against thieves
+        bool won = _top.compare_exchange_strong(t, t + 1,
+                                                std::memory_order_seq_cst,
+                                                std::memory_order_relaxed);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    bool steal(std::uint64_t &range)
+    {
+        std::int64_t t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = _bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return false;
+        }
+        range = _buf[t % CAPACITY].load(std::memory_order_relaxed);
+        return _top.compare_exchange_strong(t, t + 1,
+                                            std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    }
+};
+
+// Graph prefetch hooks of the top-down step, no-ops for unknown graphs
+template <typename GraphType>
+void _prefetch_vertex(const GraphType &, VertIdx_t)
+{
+}
+
+template <typename GraphType>
+void _prefetch_edges(const GraphType &, VertIdx_t)
+{
+}
+
+// Vector-backed adjacency lists keep a record per vertex pointing at its
+// out-edge array, so both can be requested before either is needed
+template <typename Directed, typename VertProp, typename EdgeProp,
+          typename GraphProp, typename EdgeList>
+void _prefetch_vertex(const boost::adjacency_list<boost::vecS, boost::vecS,
+                                                  Directed, VertProp, EdgeProp,
+                                                  GraphProp, EdgeList> &G,
+                      VertIdx_t idx)
+{
+    __builtin_prefetch(G.m_vertices.data() + idx);
+}
+
+template <typename Directed, typename VertProp, typename EdgeProp,
+          typename GraphProp, typename EdgeList>
+void _prefetch_edges(const boost::adjacency_list<boost::vecS, boost::vecS,
+                                                 Directed, VertProp, EdgeProp,
+                                                 GraphProp, EdgeList> &G,
+                     VertIdx_t idx)
+{
+    __builtin_prefetch(G.out_edge_list(idx).data());
+}
+
 namespace unlimited_threads {
-template <typename GraphType, typename VisitorType>
-static void _traverse_vert(const GraphType &G, ThreadData &data,
-                           VisitorType &visitor,
-                           std::vector<AtomicWrapper<VertColor>> &visited)
+// Frontier slots, one per vertex plus one per out-edge, per dispatch
+constexpr std::size_t SLOT_CHUNK = 256;
+
+// Scratch space of the edge-balanced top-down step, kept across levels
+struct TopDownScratch {
+    std::vector<std::size_t> slots;
+    std::vector<std::size_t> scan_scratch;
+    std::vector<std::vector<VertIdx_t>> split;
+
+    explicit TopDownScratch(std::size_t thread_cnt) : split(thread_cnt) {}
+};
+
+template <typename GraphType, typename EdgeType, typename VisitorType,
+          typename VisitedType>
+static void _traverse_edge(const GraphType &G, const EdgeType &edge,
+                           VisitorType &visitor, VisitedType &visited,
+                           std::vector<VertIdx_t> &next_lvl)
 {
-    visitor.examine_vertex(data.idx, G);
+    visitor.examine_edge(edge, G);
+    VertIdx_t adj_idx = boost::target(edge, G);
+    if (visited.try_discover(adj_idx)) {
+        visitor.tree_edge(edge, G);
+        visitor.discover_vertex(adj_idx, G);
+        next_lvl.push_back(adj_idx);
+        return;
+    }
 
-    const auto &edges = boost::out_edges(data.idx, G);
-    for (auto i = edges.first; i != edges.second; i++) {
-        visitor.examine_edge(*i, G);
-        VertIdx_t adj_idx = boost::target(*i, G);
-        VertColor expected = WHITE;
-        if (visited[adj_idx].compare_exchange_strong(expected, GRAY)) {
-            visitor.tree_edge(*i, G);
-            visitor.discover_vertex(adj_idx, G);
-            data.adj_list.push_back(adj_idx);
-        } else if (visited[adj_idx].load() == GRAY) {
-            visitor.non_tree_edge(*i, G);
-            visitor.gray_target(*i, G);
+    visitor.non_tree_edge(edge, G);
+    // The finished load is only paid for by visitors that tell targets apart
+    if constexpr (_classifies_targets<VisitorType, GraphType>()) {
+        if (!visited.is_finished(adj_idx)) {
+            visitor.gray_target(edge, G);
         } else {
-            visitor.non_tree_edge(*i, G);
-            visitor.black_target(*i, G);
+            visitor.black_target(edge, G);
         }
     }
-
-    visited[data.idx] = BLACK;
-    visitor.finish_vertex(data.idx, G);
-    data.is_done = true;
 }
 
-template <typename GraphType, typename VisitorType>
-void _breadth_first_search(const GraphType &G, VertIdx_t start,
-                           VisitorType &visitor)
+template <typename GraphType, typename VisitorType, typename VisitedType>
+static void _traverse_vert(const GraphType &G, VertIdx_t idx,
+                           VisitorType &visitor, VisitedType &visited,
+                           std::vector<VertIdx_t> &next_lvl)
 {
-    std::vector<AtomicWrapper<VertColor>> visited(boost::num_vertices(G),
-                                                  WHITE);
+    visitor.examine_vertex(idx, G);
 
-    auto vert_pair = boost::vertices(G);
-    for (auto i = vert_pair.first; i != vert_pair.second; i++) {
-        visitor.initialize_vertex(*i, G);
+    const auto &edges = boost::out_edges(idx, G);
+    for (auto i = edges.first; i != edges.second; i++) {
+        _traverse_edge(G, *i, visitor, visited, next_lvl);
     }
 
-    std::list<VertIdx_t> curr_lvl;
-    std::list<ThreadData> next_lvl;
-    visited[start] = GRAY;
-    visitor.discover_vertex(start, G);
-    curr_lvl.push_back(start);
-    do {
-        std::list<std::thread> thread_list;
-        for (VertIdx_t vert_idx : curr_lvl) {
-            next_lvl.push_back({.idx = vert_idx,
-                                .adj_list = std::list<VertIdx_t>(),
-                                .is_done = false});
-            thread_list.push_back(
-                std::thread(_traverse_vert<GraphType, VisitorType>, std::ref(G),
-                            std::ref(next_lvl.back()), std::ref(visitor),
-                            std::ref(visited)));
+    if constexpr (_classifies_targets<VisitorType, GraphType>()) {
+        visited.finish(idx);
+    }
+    visitor.finish_vertex(idx, G);
+}
+
+/**
+ * @brief Expands a level with every thread getting an equal share of edges.
+ * Each frontier vertex owns one slot for itself followed by one per out-edge;
+ * a prefix sum over the slot counts lets a chunk of slots start mid-list, so
+ * hub adjacencies are split across threads. Vertices split that way are
+ * finished after the whole level. Works on any frontier with the sparse
+ * Frontier interface and any visited set with the VisitedSet interface.
+ *
+ * With a nonzero prefetch distance each chunk first requests the vertex
+ * records, then the adjacency arrays, of all its frontier vertices, and the
+ * edge loop requests the visited mark of the target that many edges ahead.
+ * The misses of a chunk then overlap instead of stalling one at a time.
+ * Once stop fires, the remaining chunks are skipped and the level is left
+ * incomplete.
+ */
+template <typename GraphType, typename VisitorType, typename VisitedType,
+          typename FrontierType>
+static void _top_down_step(const GraphType &G, VisitorType &visitor,
+                           VisitedType &visited, FrontierType &curr_lvl,
+                           std::vector<std::vector<VertIdx_t>> &next_lvl,
+                           TopDownScratch &scratch,
+                           std::size_t prefetch = 0,
+                           StopSignal *stop = nullptr)
+{
+    ThreadPool &pool = ThreadPool::global();
+    std::vector<std::size_t> &slots = scratch.slots;
+
+    constexpr bool FINISHES = _finishes_vertices<VisitorType, GraphType>();
+    auto finish = [&](VertIdx_t idx) {
+        if constexpr (_classifies_targets<VisitorType, GraphType>()) {
+            visited.finish(idx);
         }
+        visitor.finish_vertex(idx, G);
+    };
 
-        curr_lvl.clear();
-        while (!next_lvl.empty()) { // Waiting
-            auto next_lvl_i = next_lvl.begin();
-            while (next_lvl_i != next_lvl.end()) {
-                auto del_ref = next_lvl_i;
-                if (next_lvl_i->is_done) {
-                    curr_lvl.splice(curr_lvl.end(), next_lvl_i->adj_list);
+    curr_lvl.to_sparse(pool);
+    std::size_t vert_cnt = curr_lvl.size();
+    slots.resize(vert_cnt);
+    pool.parallel_for(0, vert_cnt, 1024,
+                      [&](std::size_t lo, std::size_t hi, std::size_t) {
+                          for (std::size_t i = lo; i < hi; i++) {
+                              slots[i] = boost::out_degree(curr_lvl[i], G) + 1;
+                          }
+                      });
+    std::size_t slot_cnt =
+        parallel_exclusive_scan(pool, slots, scratch.scan_scratch);
+
+    auto expand = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+        if (_should_stop(stop)) {
+            return;
+        }
+        auto slot_i = std::upper_bound(slots.begin(), slots.end(), lo);
+        std::size_t i = slot_i - slots.begin() - 1;
+        if (prefetch != 0) {
+            std::size_t i_end = i;
+            for (; i_end < vert_cnt && slots[i_end] < hi; i_end++) {
+                _prefetch_vertex(G, curr_lvl[i_end]);
+            }
+            for (std::size_t j = i; j < i_end; j++) {
+                _prefetch_edges(G, curr_lvl[j]);
+            }
+        }
+        for (; i < vert_cnt && slots[i] < hi; i++) {
+            VertIdx_t idx = curr_lvl[i];
+            std::size_t first = slots[i];
+            std::size_t last = (i + 1 < vert_cnt) ? slots[i + 1] : slot_cnt;
+            std::size_t slot_lo = std::max(lo, first) - first;
+            std::size_t slot_hi = std::min(hi, last) - first;
+
+            if (slot_lo == 0) {
+                visitor.examine_vertex(idx, G);
+            }
+            std::size_t edge_lo = (slot_lo == 0) ? 0 : slot_lo - 1;
+            const auto &edges = boost::out_edges(idx, G);
+            auto edge_end = std::next(edges.first, slot_hi - 1);
+            auto e = std::next(edges.first, edge_lo);
+            if (prefetch != 0) {
+                std::size_t lead = std::min(prefetch, slot_hi - 1 - edge_lo);
+                auto ahead = e;
+                for (std::size_t k = 0; k < lead; k++, ahead++) {
+                    visited.prefetch(boost::target(*ahead, G));
+                }
+                for (; ahead != edge_end; e++, ahead++) {
+                    visited.prefetch(boost::target(*ahead, G));
+                    _traverse_edge(G, *e, visitor, visited, next_lvl[tid]);
+                }
+            }
+            for (; e != edge_end; e++) {
+                _traverse_edge(G, *e, visitor, visited, next_lvl[tid]);
+            }
+
+            if constexpr (FINISHES) {
+                if (first + slot_hi != last) {
+                    continue;
                 }
-                next_lvl_i++; // increment before deleting
-                if (del_ref->is_done) {
-                    next_lvl.erase(del_ref);
+                if (slot_lo == 0) {
+                    finish(idx);
+                } else {
+                    scratch.split[tid].push_back(idx);
                 }
             }
         }
+    };
+    pool.parallel_for(0, slot_cnt, SLOT_CHUNK, expand);
 
-        for (std::thread &t : thread_list) {
-            t.join();
+    for (std::vector<VertIdx_t> &split : scratch.split) {
+        for (VertIdx_t idx : split) {
+            finish(idx);
         }
-    } while (!curr_lvl.empty());
+        split.clear();
+    }
+}
+
+// Returns the depth of the last complete level
+template <typename GraphType, typename VisitorType>
+std::size_t _breadth_first_search(const GraphType &G, VertIdx_t start,
+                                  VisitorType &visitor,
+                                  std::size_t prefetch = 0,
+                                  StopSignal *stop = nullptr)
+{
+    ThreadPool &pool = ThreadPool::global();
+    VisitedSet visited(boost::num_vertices(G),
+                       _classifies_targets<VisitorType, GraphType>());
+
+    if constexpr (EventUse<VisitorType, GraphType>::initialize_vertex) {
+        auto vert_pair = boost::vertices(G);
+        for (auto i = vert_pair.first; i != vert_pair.second; i++) {
+            visitor.initialize_vertex(*i, G);
+        }
+    }
+
+    // One discovery buffer per pool thread, kept across levels
+    Frontier curr_lvl(boost::num_vertices(G));
+    std::vector<std::vector<VertIdx_t>> next_lvl(pool.concurrency());
+    TopDownScratch scratch(pool.concurrency());
+    visited.discover(start);
+    visitor.discover_vertex(start, G);
+    curr_lvl.push_back(start);
+    std::size_t depth = 0;
+    while (true) {
+        _top_down_step(G, visitor, visited, curr_lvl, next_lvl, scratch,
+                       prefetch, stop);
+        if (_stopped(stop)) {
+            return depth;
+        }
+        curr_lvl.assign(pool, next_lvl);
+        _end_level(visitor);
+        if (curr_lvl.empty()) {
+            return depth;
+        }
+        depth++;
+    }
 }
 } // namespace unlimited_threads
 
@@ -123,7 +815,7 @@ template <typename GraphType, typename VisitorType>
 static void _traverse_vert(const GraphType &G, VertIdx_t idx,
                            VisitorType &visitor,
                            std::list<VertIdx_t> &next_idxs,
-                           std::vector<AtomicWrapper<VertColor>> &visited)
+                           VisitedSet &visited)
 {
     visitor.examine_vertex(idx, G);
 
@@ -131,12 +823,11 @@ static void _traverse_vert(const GraphType &G, VertIdx_t idx,
     for (auto i = edges.first; i != edges.second; i++) {
         visitor.examine_edge(*i, G);
         VertIdx_t adj_idx = boost::target(*i, G);
-        VertColor expected = WHITE;
-        if (visited[adj_idx].compare_exchange_strong(expected, GRAY)) {
+        if (visited.try_discover(adj_idx)) {
             visitor.tree_edge(*i, G);
             visitor.discover_vertex(adj_idx, G);
             next_idxs.push_back(adj_idx);
-        } else if (visited[adj_idx].load() == GRAY) {
+        } else if (!visited.is_finished(adj_idx)) {
             visitor.non_tree_edge(*i, G);
             visitor.gray_target(*i, G);
         } else {
@@ -145,7 +836,7 @@ static void _traverse_vert(const GraphType &G, VertIdx_t idx,
         }
     }
 
-    visited[idx] = BLACK;
+    visited.finish(idx);
     visitor.finish_vertex(idx, G);
 }
 
@@ -153,8 +844,7 @@ template <typename GraphType, typename VisitorType>
 void _breadth_first_search(const GraphType &G, VertIdx_t start,
                            VisitorType &visitor)
 {
-    std::vector<AtomicWrapper<VertColor>> visited(boost::num_vertices(G),
-                                                  WHITE);
+    VisitedSet visited(boost::num_vertices(G));
 
     auto vert_pair = boost::vertices(G);
     for (auto i = vert_pair.first; i != vert_pair.second; i++) {
@@ -163,7 +853,7 @@ void _breadth_first_search(const GraphType &G, VertIdx_t start,
 
     std::list<VertIdx_t> curr_lvl;
     std::list<std::list<VertIdx_t>> next_lvl;
-    visited[start] = GRAY;
+    visited.discover(start);
     visitor.discover_vertex(start, G);
     next_lvl.push_back(std::list{start});
     do {
@@ -193,8 +883,7 @@ namespace fixed_thread_count {
 
 template <typename GraphType, typename VisitorType>
 static void _traverse_vert(const GraphType &G, ThreadData &data,
-                           VisitorType &visitor,
-                           std::vector<AtomicWrapper<VertColor>> &visited,
+                           VisitorType &visitor, VisitedSet &visited,
                            std::vector<std::size_t> &depth)
 {
     visitor.examine_vertex(data.idx, G);
@@ -203,13 +892,12 @@ static void _traverse_vert(const GraphType &G, ThreadData &data,
     for (auto i = edges.first; i != edges.second; i++) {
         visitor.examine_edge(*i, G);
         VertIdx_t adj_idx = boost::target(*i, G);
-        VertColor expected = WHITE;
-        if (visited[adj_idx].compare_exchange_strong(expected, GRAY)) {
+        if (visited.try_discover(adj_idx)) {
             visitor.tree_edge(*i, G);
             visitor.discover_vertex(adj_idx, G);
             data.adj_list.push_back(adj_idx); //
             depth[adj_idx] = depth[data.idx] + 1;
-        } else if (visited[adj_idx].load() == GRAY) {
+        } else if (!visited.is_finished(adj_idx)) {
             visitor.non_tree_edge(*i, G);
             visitor.gray_target(*i, G);
         } else {
@@ -218,7 +906,7 @@ static void _traverse_vert(const GraphType &G, ThreadData &data,
         }
     }
 
-    visited[data.idx] = BLACK;
+    visited.finish(data.idx);
     visitor.finish_vertex(data.idx, G);
     data.is_done = true; //
 }
@@ -227,8 +915,7 @@ template <std::size_t THREAD_CNT, typename GraphType, typename VisitorType>
 static void _breadth_first_search(const GraphType &G, VertIdx_t start,
                                   VisitorType &visitor)
 {
-    std::vector<AtomicWrapper<VertColor>> visited(boost::num_vertices(G),
-                                                  WHITE);
+    VisitedSet visited(boost::num_vertices(G));
     std::vector<std::size_t> depth(boost::num_vertices(G), 0);
 
     auto vert_pair = boost::vertices(G);
@@ -243,7 +930,7 @@ static void _breadth_first_search(const GraphType &G, VertIdx_t start,
     std::size_t curr_depth = 0;
     data.fill({.is_done = true});
 
-    visited[start] = GRAY;
+    visited.discover(start);
     depth[start] = 0;
     visitor.discover_vertex(start, G);
     queue.push_back(start);
@@ -277,18 +964,405 @@ static void _breadth_first_search(const GraphType &G, VertIdx_t start,
     } while (!queue.empty());
 }
 } // namespace fixed_thread_count
+
+namespace work_stealing {
+// Ranges at most this long are traversed instead of being split further
+constexpr std::size_t STEAL_GRAIN = 32;
+
+template <std::size_t THREAD_CNT>
+static bool _steal(std::array<ChaseLevDeque, THREAD_CNT> &deques,
+                   std::size_t thief, std::uint64_t &range)
+{
+    for (std::size_t i = 1; i < THREAD_CNT; i++) {
+        if (deques[(thief + i) % THREAD_CNT].steal(range)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <std::size_t THREAD_CNT, typename GraphType, typename VisitorType>
+static void _work(const GraphType &G, std::size_t worker,
+                  VisitorType &visitor, VisitedSet &visited,
+                  const Frontier &curr_lvl, std::vector<VertIdx_t> &next_lvl,
+                  std::array<ChaseLevDeque, THREAD_CNT> &deques,
+                  std::atomic<std::size_t> &remaining)
+{
+    ChaseLevDeque &own = deques[worker];
+    while (remaining.load() > 0) {
+        std::uint64_t range;
+        if (!own.pop(range) && !_steal(deques, worker, range)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Keep the lower half, leave the upper half for thieves
+        std::size_t lo, hi;
+        ChaseLevDeque::unpack(range, lo, hi);
+        while (hi - lo > STEAL_GRAIN) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            if (!own.push(ChaseLevDeque::pack(mid, hi))) {
+                break;
+            }
+            hi = mid;
+        }
+
+        for (std::size_t i = lo; i < hi; i++) {
+            unlimited_threads::_traverse_vert(G, curr_lvl[i], visitor, visited,
+                                              next_lvl);
+        }
+        remaining.fetch_sub(hi - lo);
+    }
+}
+
+template <std::size_t THREAD_CNT, typename GraphType, typename VisitorType>
+static void _breadth_first_search(const GraphType &G, VertIdx_t start,
+                                  VisitorType &visitor)
+{
+    static_assert(THREAD_CNT > 0, "work stealing needs at least one worker");
+
+    ThreadPool &pool = ThreadPool::global();
+    VisitedSet visited(boost::num_vertices(G),
+                       _classifies_targets<VisitorType, GraphType>());
+
+    if constexpr (EventUse<VisitorType, GraphType>::initialize_vertex) {
+        auto vert_pair = boost::vertices(G);
+        for (auto i = vert_pair.first; i != vert_pair.second; i++) {
+            visitor.initialize_vertex(*i, G);
+        }
+    }
+
+    std::array<ChaseLevDeque, THREAD_CNT> deques;
+    std::array<std::vector<VertIdx_t>, THREAD_CNT> next_lvl;
+    Frontier curr_lvl(boost::num_vertices(G)); // always sparse here
+    std::atomic<std::size_t> remaining;
+    visited.discover(start);
+    visitor.discover_vertex(start, G);
+    curr_lvl.push_back(start);
+    do {
+        // Every worker starts the level owning one contiguous slice
+        for (std::size_t w = 0; w < THREAD_CNT; w++) {
+            std::size_t lo = curr_lvl.size() * w / THREAD_CNT;
+            std::size_t hi = curr_lvl.size() * (w + 1) / THREAD_CNT;
+            deques[w].reset();
+            if (lo < hi) {
+                deques[w].push(ChaseLevDeque::pack(lo, hi));
+            }
+        }
+        remaining = curr_lvl.size();
+
+        pool.parallel_for(0, THREAD_CNT, 1,
+                          [&](std::size_t lo, std::size_t hi, std::size_t) {
+                              for (std::size_t w = lo; w < hi; w++) {
+                                  _work(G, w, visitor, visited, curr_lvl,
+                                        next_lvl[w], deques, remaining);
+                              }
+                          });
+
+        curr_lvl.assign(pool, next_lvl);
+        _end_level(visitor);
+    } while (!curr_lvl.empty());
+}
+} // namespace work_stealing
+
+namespace direction_optimizing {
+// Vertices per chunk for the bottom-up sweep over all vertices
+constexpr std::size_t SWEEP_CHUNK = 256;
+
+template <typename GraphType, typename VisitorType>
+static std::size_t
+_bottom_up_step(const GraphType &G, VisitorType &visitor,
+                const ReverseGraph<GraphType> &reverse, VisitedSet &visited,
+                const Frontier &curr_lvl, Frontier &next_lvl,
+                std::vector<std::size_t> &found, StopSignal *stop)
+{
+    ThreadPool &pool = ThreadPool::global();
+    AtomicBitmap &next_bits = next_lvl.bits();
+    std::fill(found.begin(), found.end(), 0);
+    auto sweep = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+        if (_should_stop(stop)) {
+            return;
+        }
+        for (VertIdx_t v = lo; v < hi; v++) {
+            if (visited.is_discovered(v)) {
+                continue;
+            }
+            // v is only ever written by this thread during the sweep
+            auto edges = reverse.in_edges(v);
+            for (auto i = edges.first; i != edges.second; i++) {
+                visitor.examine_edge(*i, G);
+                if (curr_lvl.contains(boost::source(*i, G))) {
+                    visited.discover(v);
+                    visitor.tree_edge(*i, G);
+                    visitor.discover_vertex(v, G);
+                    next_bits.set(v);
+                    found[tid]++;
+                    break;
+                }
+            }
+        }
+    };
+    pool.parallel_for(0, boost::num_vertices(G), SWEEP_CHUNK, sweep);
+    return std::accumulate(found.begin(), found.end(), std::size_t(0));
+}
+
+// Returns the depth of the last complete level
+template <typename GraphType, typename VisitorType>
+std::size_t _breadth_first_search(const GraphType &G, VertIdx_t start,
+                                  VisitorType &visitor, const BfsOptions &opts,
+                                  const ReverseGraph<GraphType> *reverse,
+                                  StopSignal *stop = nullptr)
+{
+    typedef EventUse<VisitorType, GraphType> Uses;
+    constexpr bool CLASSIFIES = _classifies_targets<VisitorType, GraphType>();
+
+    ThreadPool &pool = ThreadPool::global();
+    std::size_t vert_cnt = boost::num_vertices(G);
+    VisitedSet visited(vert_cnt, CLASSIFIES);
+    std::unique_ptr<ReverseGraph<GraphType>> owned_reverse;
+
+    if constexpr (Uses::initialize_vertex) {
+        auto vert_pair = boost::vertices(G);
+        for (auto i = vert_pair.first; i != vert_pair.second; i++) {
+            visitor.initialize_vertex(*i, G);
+        }
+    }
+
+    Frontier curr_lvl(vert_cnt);
+    Frontier next_lvl(vert_cnt);
+    std::vector<std::vector<VertIdx_t>> next_bufs(pool.concurrency());
+    std::vector<std::size_t> thread_sums(pool.concurrency());
+    unlimited_threads::TopDownScratch scratch(pool.concurrency());
+    visited.discover(start);
+    visitor.discover_vertex(start, G);
+    curr_lvl.push_back(start);
+
+    // Out-edges of the frontier (m_f) and of still unvisited vertices (m_u)
+    double frontier_edges = boost::out_degree(start, G);
+    double unexplored_edges = boost::num_edges(G) - frontier_edges;
+    bool bottom_up = false;
+    std::size_t depth = 0;
+    while (true) {
+        if (!bottom_up) {
+            bottom_up = frontier_edges > unexplored_edges / opts.alpha;
+        } else {
+            bottom_up = curr_lvl.size() >= vert_cnt / opts.beta;
+        }
+
+        if (!bottom_up) {
+            unlimited_threads::_top_down_step(G, visitor, visited, curr_lvl,
+                                              next_bufs, scratch,
+                                              opts.prefetch_distance, stop);
+            if (_stopped(stop)) {
+                return depth;
+            }
+            curr_lvl.assign(pool, next_bufs);
+        } else {
+            if (reverse == nullptr) {
+                owned_reverse = std::make_unique<ReverseGraph<GraphType>>(G);
+                reverse = owned_reverse.get();
+            }
+            curr_lvl.to_dense(pool);
+            if constexpr (Uses::examine_vertex) {
+                curr_lvl.for_each(pool, SWEEP_CHUNK,
+                                  [&](VertIdx_t idx, std::size_t) {
+                                      visitor.examine_vertex(idx, G);
+                                  });
+            }
+            std::size_t found = _bottom_up_step(G, visitor, *reverse, visited,
+                                                curr_lvl, next_lvl,
+                                                thread_sums, stop);
+            if (_stopped(stop)) {
+                return depth;
+            }
+            if constexpr (_finishes_vertices<VisitorType, GraphType>()) {
+                curr_lvl.for_each(
+                    pool, SWEEP_CHUNK, [&](VertIdx_t idx, std::size_t) {
+                        if constexpr (CLASSIFIES) {
+                            visited.finish(idx);
+                        }
+                        visitor.finish_vertex(idx, G);
+                    });
+            }
+            next_lvl.assign_dense(found);
+            std::swap(curr_lvl, next_lvl);
+            next_lvl.clear(pool);
+        }
+        _end_level(visitor);
+        if (curr_lvl.empty()) {
+            return depth;
+        }
+        depth++;
+        curr_lvl.adapt(pool);
+
+        std::fill(thread_sums.begin(), thread_sums.end(), 0);
+        curr_lvl.for_each(pool, SWEEP_CHUNK,
+                          [&](VertIdx_t idx, std::size_t tid) {
+                              thread_sums[tid] += boost::out_degree(idx, G);
+                          });
+        frontier_edges =
+            std::accumulate(thread_sums.begin(), thread_sums.end(), 0.0);
+        unexplored_edges -= frontier_edges;
+    }
+}
+} // namespace direction_optimizing
+
+namespace depth_bounded {
+/**
+ * @brief Top-down BFS that stops after max_depth levels and only touches
+ * reached vertices: an epoch-stamped visited set and frontiers sized by the
+ * levels replace the per-vertex arrays, and vertices are initialised as they
+ * are discovered. on_level(depth, frontier) sees each level once it is
+ * complete, the start vertex being level 0. Returns the depth of the last
+ * complete level.
+ */
+template <typename GraphType, typename VisitorType, typename LevelFunc>
+std::size_t _breadth_first_search(const GraphType &G, VertIdx_t start,
+                                  VisitorType &visitor, std::size_t max_depth,
+                                  LevelFunc &&on_level,
+                                  std::size_t prefetch = 0,
+                                  StopSignal *stop = nullptr)
+{
+    ThreadPool &pool = ThreadPool::global();
+    EpochVisitedSet visited(boost::num_vertices(G));
+    LazyInitVisitor<VisitorType> lazy_visitor(visitor);
+
+    SparseFrontier curr_lvl;
+    std::vector<std::vector<VertIdx_t>> next_lvl(pool.concurrency());
+    unlimited_threads::TopDownScratch scratch(pool.concurrency());
+    visitor.initialize_vertex(start, G);
+    visited.discover(start);
+    visitor.discover_vertex(start, G);
+    curr_lvl.push_back(start);
+    on_level(0, curr_lvl);
+    for (std::size_t depth = 1; depth <= max_depth; depth++) {
+        unlimited_threads::_top_down_step(G, lazy_visitor, visited, curr_lvl,
+                                          next_lvl, scratch, prefetch, stop);
+        if (_stopped(stop)) {
+            return depth - 1;
+        }
+        curr_lvl.assign(pool, next_lvl);
+        _end_level(lazy_visitor);
+        if (curr_lvl.empty()) {
+            return depth - 1;
+        }
+        on_level(depth, curr_lvl);
+    }
+    return max_depth;
+}
+} // namespace depth_bounded
+
+namespace label_correcting {
+// Depth in the high half, parent in the low half: an atomic min over labels
+// keeps the shallowest depth and breaks ties by the smallest parent
+constexpr std::uint64_t NO_LABEL = ~std::uint64_t(0);
+
+inline std::uint64_t _pack(std::size_t depth, VertIdx_t idx)
+{
+    return (static_cast<std::uint64_t>(depth) << 32) |
+           static_cast<std::uint32_t>(idx);
+}
+
+inline std::size_t _depth(std::uint64_t label) { return label >> 32; }
+
+inline VertIdx_t _vertex(std::uint64_t label)
+{
+    return static_cast<std::uint32_t>(label);
+}
+
+// Lowers label to cand, returns whether cand won. prev, when set, gets the
+// label held before, or the one that beat cand
+inline bool _relax(std::atomic<std::uint64_t> &label, std::uint64_t cand,
+                   std::uint64_t *prev = nullptr)
+{
+    std::uint64_t curr = label.load(std::memory_order_relaxed);
+    bool won = false;
+    while (cand < curr && !won) {
+        won = label.compare_exchange_weak(curr, cand,
+                                          std::memory_order_relaxed);
+    }
+    if (prev != nullptr) {
+        *prev = curr;
+    }
+    return won;
+}
+
+template <typename GraphType>
+static void _work(const GraphType &G,
+                  std::vector<AtomicWrapper<std::uint64_t>> &labels,
+                  boost::lockfree::queue<std::uint64_t> &queue,
+                  std::atomic<std::size_t> &pending)
+{
+    std::uint64_t item;
+    while (true) {
+        if (!queue.pop(item)) {
+            if (pending.load() == 0) {
+                return;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Items are (depth, vertex); skip them once the vertex improved again
+        VertIdx_t idx = _vertex(item);
+        std::size_t depth = _depth(item);
+        if (_depth(labels[idx].load(std::memory_order_relaxed)) == depth) {
+            const auto &edges = boost::out_edges(idx, G);
+            for (auto i = edges.first; i != edges.second; i++) {
+                VertIdx_t adj_idx = boost::target(*i, G);
+                if (_relax(labels[adj_idx], _pack(depth + 1, idx))) {
+                    pending++;
+                    queue.push(_pack(depth + 1, adj_idx));
+                }
+            }
+        }
+        pending--;
+    }
+}
+
+template <typename GraphType>
+void _breadth_first_search(const GraphType &G, VertIdx_t start,
+                           std::vector<AtomicWrapper<std::uint64_t>> &labels)
+{
+    ThreadPool &pool = ThreadPool::global();
+    boost::lockfree::queue<std::uint64_t> queue(boost::num_vertices(G));
+    std::atomic<std::size_t> pending(1);
+
+    labels[start] = _pack(0, start);
+    queue.push(_pack(0, start));
+    pool.parallel_for(0, pool.concurrency(), 1,
+                      [&](std::size_t, std::size_t, std::size_t) {
+                          _work(G, labels, queue, pending);
+                      });
+}
+} // namespace label_correcting
 } // namespace impl
 
 enum ThreadCountOpt { UNLIMITED_THREADS = 0 };
 
+/**
+ * @brief Makes the shared pool NUMA-aware for the rest of the process: its
+ * workers are pinned across the nodes of topology and every vertex-range
+ * loop, including the first touch of visited sets and frontiers, is split
+ * so each node mostly works on its own range. On single-node machines this
+ * only pins workers to the CPUs they may already use.
+ */
+inline void enable_numa(const NumaTopology &topology = NumaTopology::system())
+{
+    impl::ThreadPool::global().enable_numa(topology);
+}
+
 template <std::size_t THREAD_CNT, typename GraphType, typename VisitorType>
 void breadth_first_search(const GraphType &G, VertIdx_t start,
                           VisitorType &visitor)
 {
     switch (THREAD_CNT) {
-    case UNLIMITED_THREADS:
+    case UNLIMITED_THREADS: {
+        impl::ThreadPool::ScopedDispatch dispatch(impl::ThreadPool::global(),
+                                                  0, BLOCK_WAIT);
         impl::unlimited_threads::_breadth_first_search(G, start, visitor);
         break;
+    }
 
     default:
         impl::fixed_thread_count::_breadth_first_search<THREAD_CNT>(G, start,
@@ -296,4 +1370,152 @@ void breadth_first_search(const GraphType &G, VertIdx_t start,
         break;
     }
 }
+
+/**
+ * @brief Runs THREAD_CNT workers that each start a level on an even slice of
+ * the frontier and, once their own ranges run out, steal the upper halves of
+ * the ranges other workers have left.
+ */
+template <std::size_t THREAD_CNT, typename GraphType, typename VisitorType>
+void work_stealing_breadth_first_search(const GraphType &G, VertIdx_t start,
+                                        VisitorType &visitor)
+{
+    impl::ThreadPool::ScopedDispatch dispatch(impl::ThreadPool::global(),
+                                              THREAD_CNT, BLOCK_WAIT);
+    impl::work_stealing::_breadth_first_search<THREAD_CNT>(G, start, visitor);
+}
+
+/**
+ * @brief Runs the pool-based engine configured by opts, with the thread count
+ * and wait strategy chosen at run time. reverse is only used for bottom-up
+ * levels; when it is null and one is needed, an in-edge index is built for
+ * this call. With opts.parent set, the BFS tree is written there as vertices
+ * are discovered; validate_bfs_tree checks it. With opts.max_depth set,
+ * initialize_vertex is only called for reached vertices, right before their
+ * tree edge. With opts.cancel or opts.deadline set, the workers check both
+ * before every chunk and the traversal returns as soon as the chunks in
+ * flight are done, reporting the levels it completed.
+ */
+template <typename GraphType, typename VisitorType>
+BfsOutcome
+breadth_first_search(const GraphType &G, VertIdx_t start, VisitorType &visitor,
+                     const BfsOptions &opts,
+                     const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    impl::ThreadPool &pool = impl::ThreadPool::global();
+    impl::ThreadPool::ScopedDispatch dispatch(pool, opts.threads, opts.wait);
+    impl::StopSignal signal(opts);
+    impl::StopSignal *stop = signal.armed() ? &signal : nullptr;
+    auto run = [&](auto &vis) {
+        BfsOutcome res;
+        if (opts.max_depth != UNREACHED) {
+            res.depth = impl::depth_bounded::_breadth_first_search(
+                G, start, vis, opts.max_depth,
+                [](std::size_t, const impl::SparseFrontier &) {},
+                opts.prefetch_distance, stop);
+        } else if (opts.direction_optimizing) {
+            res.depth = impl::direction_optimizing::_breadth_first_search(
+                G, start, vis, opts, reverse, stop);
+        } else {
+            res.depth = impl::unlimited_threads::_breadth_first_search(
+                G, start, vis, opts.prefetch_distance, stop);
+        }
+        res.complete = !signal.stopped();
+        return res;
+    };
+    if (opts.parent == nullptr) {
+        return run(visitor);
+    }
+
+    std::vector<VertIdx_t> &parent = *opts.parent;
+    parent.resize(boost::num_vertices(G));
+    pool.parallel_for(0, parent.size(), 1024,
+                      [&](std::size_t lo, std::size_t hi, std::size_t) {
+                          std::fill(parent.begin() + lo, parent.begin() + hi,
+                                    NO_PARENT);
+                      });
+    parent[start] = start;
+    impl::ParentRecorder<VisitorType> recorder(visitor, parent);
+    return run(recorder);
+}
+
+/**
+ * @brief Runs the engine of the options overload above with one visitor per
+ * pool thread, made by make_visitor(tid), so that visitors need neither
+ * atomics nor locks. Events outside of parallel loops, such as
+ * initialize_vertex, go to clone 0. If the visitor type has
+ * merge(VisitorType &other), which should move the state of other into it,
+ * all clones are merged into clone 0 in thread order at the end of every
+ * level; for merges that do not depend on order the result is the same for
+ * every run. Returns clone 0.
+ */
+template <typename GraphType, typename Factory>
+auto per_thread_breadth_first_search(
+    const GraphType &G, VertIdx_t start, Factory make_visitor,
+    const BfsOptions &opts = {},
+    const ReverseGraph<GraphType> *reverse = nullptr)
+{
+    typedef decltype(make_visitor(std::size_t(0))) VisitorType;
+
+    impl::ThreadPool &pool = impl::ThreadPool::global();
+    impl::ThreadPool::ScopedDispatch dispatch(pool, opts.threads, opts.wait);
+    impl::ThreadVisitors<VisitorType> visitors(pool.concurrency(),
+                                               make_visitor);
+    breadth_first_search(G, start, visitors, opts, reverse);
+    visitors.merge_clones();
+    return std::move(visitors.merged());
+}
+
+/**
+ * @brief Every vertex at most max_depth hops from start with its depth, level
+ * by level. Costs scale with the size of that neighbourhood, not with the
+ * graph.
+ */
+template <typename GraphType>
+std::vector<std::pair<VertIdx_t, std::size_t>>
+k_hop_neighbourhood(const GraphType &G, VertIdx_t start, std::size_t max_depth,
+                    const BfsOptions &opts = {})
+{
+    impl::ThreadPool::ScopedDispatch dispatch(impl::ThreadPool::global(),
+                                              opts.threads, opts.wait);
+    std::vector<std::pair<VertIdx_t, std::size_t>> reached;
+    boost::default_bfs_visitor visitor;
+    impl::depth_bounded::_breadth_first_search(
+        G, start, visitor, max_depth,
+        [&](std::size_t depth, const impl::SparseFrontier &lvl) {
+            for (VertIdx_t idx : lvl) {
+                reached.emplace_back(idx, depth);
+            }
+        },
+        opts.prefetch_distance);
+    return reached;
+}
+
+/**
+ * @brief Barrier-free BFS: workers pull vertices from a shared lock-free
+ * queue and lower neighbour depths with an atomic min, re-enqueueing every
+ * vertex whose depth improves. Only depths are final once the queue drains,
+ * so instead of visitor events this writes the depth of every reached vertex
+ * to dist and leaves unreached vertices untouched.
+ */
+template <typename GraphType, typename DistMap>
+void label_correcting_bfs(const GraphType &G, VertIdx_t start, DistMap dist)
+{
+    using namespace impl::label_correcting;
+
+    std::vector<impl::AtomicWrapper<std::uint64_t>> labels(
+        boost::num_vertices(G), NO_LABEL);
+    _breadth_first_search(G, start, labels);
+
+    impl::ThreadPool::global().parallel_for(
+        0, labels.size(), 1024,
+        [&](std::size_t lo, std::size_t hi, std::size_t) {
+            for (VertIdx_t idx = lo; idx < hi; idx++) {
+                std::uint64_t label = labels[idx].load();
+                if (label != NO_LABEL) {
+                    put(dist, idx, _depth(label));
+                }
+            }
+        });
+}
 } // namespace parallel_bfs
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "main.hpp"
+#include "thread_pool.hpp"
+
+namespace parallel_bfs {
+
+/**
+ * @brief Compressed in-edge index of a graph, for pulling from predecessors
+ * on graphs that only store out-edges. Every entry is the original edge
+ * descriptor, so source() and target() keep their forward meaning.
+ *
+ * The index is a snapshot; rebuild it after the graph changes.
+ */
+template <typename GraphType> class ReverseGraph {
+  public:
+    typedef typename boost::graph_traits<GraphType>::edge_descriptor Edge;
+
+  private:
+    std::vector<std::size_t> _offsets;
+    std::vector<Edge> _edges;
+
+  public:
+    explicit ReverseGraph(const GraphType &G)
+        : _offsets(boost::num_vertices(G) + 1, 0)
+    {
+        impl::ThreadPool &pool = impl::ThreadPool::global();
+        std::size_t vert_cnt = boost::num_vertices(G);
+        std::vector<std::atomic<std::size_t>> cursor(vert_cnt + 1);
+
+        auto count = [&](std::size_t lo, std::size_t hi, std::size_t) {
+            for (VertIdx_t u = lo; u < hi; u++) {
+                const auto &edges = boost::out_edges(u, G);
+                for (auto i = edges.first; i != edges.second; i++) {
+                    VertIdx_t v = boost::target(*i, G);
+                    cursor[v].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        };
+        pool.parallel_for(0, vert_cnt, 256, count);
+
+        for (std::size_t v = 0; v < vert_cnt; v++) {
+            _offsets[v + 1] = _offsets[v] + cursor[v].load();
+            cursor[v] = _offsets[v];
+        }
+        _edges.resize(_offsets[vert_cnt]);
+
+        auto fill = [&](std::size_t lo, std::size_t hi, std::size_t) {
+            for (VertIdx_t u = lo; u < hi; u++) {
+                const auto &edges = boost::out_edges(u, G);
+                for (auto i = edges.first; i != edges.second; i++) {
+                    VertIdx_t v = boost::target(*i, G);
+                    std::size_t pos =
+                        cursor[v].fetch_add(1, std::memory_order_relaxed);
+                    _edges[pos] = *i;
+                }
+            }
+        };
+        pool.parallel_for(0, vert_cnt, 256, fill);
+    }
+
+    std::pair<const Edge *, const Edge *> in_edges(VertIdx_t v) const
+    {
+        return {_edges.data() + _offsets[v], _edges.data() + _offsets[v + 1]};
+    }
+
+    std::size_t in_degree(VertIdx_t v) const
+    {
+        return _offsets[v + 1] - _offsets[v];
+    }
+
+    std::size_t num_vertices() const { return _offsets.size() - 1; }
+};
+} // namespace parallel_bfs
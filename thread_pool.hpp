@@ -0,0 +1,405 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "numa.hpp"
+
+namespace parallel_bfs {
+
+// How a thread waits for the pool threads still working on its dispatch
+enum WaitStrategy { SPIN_WAIT, YIELD_WAIT, BLOCK_WAIT };
+
+namespace impl {
+
+/**
+ * @brief Persistent set of worker threads that execute chunked loops.
+ *
+ * Several callers may dispatch loops at the same time; each call is queued as
+ * a job and the calling thread always works on its own job, so a dispatch
+ * never waits on a worker that is not already helping.
+ */
+class ThreadPool {
+  private:
+    typedef void (*RunFn)(void *ctx, std::size_t lo, std::size_t hi,
+                          std::size_t tid);
+
+    // Most NUMA nodes a dispatch splits its range between
+    static constexpr std::size_t MAX_PARTS = 8;
+
+    // Contiguous share of a dispatch range, claimed first by one node
+    struct alignas(64) Part {
+        std::atomic<std::size_t> next;
+        std::size_t end;
+    };
+
+    struct Job {
+        RunFn run;
+        void *ctx;
+        Part parts[MAX_PARTS];
+        std::size_t part_cnt;
+        std::size_t grain;
+        std::size_t participants;
+        std::size_t joined; // guarded by _mutex
+        // Written under _mutex, spinning waiters read it without
+        std::atomic<std::size_t> active;
+    };
+
+    // Dispatch settings of the calling thread, see ScopedDispatch
+    struct DispatchConfig {
+        const ThreadPool *pool = nullptr;
+        std::size_t max_threads = 0;
+        WaitStrategy wait = BLOCK_WAIT;
+    };
+
+    std::vector<std::thread> _workers; // guarded by _mutex
+    std::atomic<std::size_t> _worker_cnt{0};
+    // Set once by enable_numa, never changed afterwards
+    std::unique_ptr<const NumaTopology> _topology;
+    std::atomic<const NumaTopology *> _numa{nullptr};
+    std::vector<std::size_t> _worker_nodes; // guarded by _mutex
+    std::deque<Job *> _jobs;
+    std::mutex _mutex;
+    std::condition_variable _work_cv;
+    std::condition_variable _done_cv;
+    bool _stop = false;
+
+    static std::size_t &_current_tid()
+    {
+        static thread_local std::size_t tid = 0;
+        return tid;
+    }
+
+    // Drains the part of node first, then helps with the others
+    static void _run_chunks(Job &job, std::size_t tid, std::size_t node)
+    {
+        std::size_t outer_tid = _current_tid();
+        _current_tid() = tid;
+        for (std::size_t p = 0; p < job.part_cnt; p++) {
+            Part &part = job.parts[(node + p) % job.part_cnt];
+            while (true) {
+                std::size_t lo = part.next.fetch_add(job.grain);
+                if (lo >= part.end) {
+                    break;
+                }
+                job.run(job.ctx, lo, std::min(lo + job.grain, part.end), tid);
+            }
+        }
+        _current_tid() = outer_tid;
+    }
+
+    // Node whose part the calling thread starts on
+    std::size_t _caller_node() const
+    {
+        const NumaTopology *numa = _numa.load(std::memory_order_acquire);
+        if (numa == nullptr) {
+            return 0;
+        }
+        int cpu = sched_getcpu();
+        return (cpu < 0) ? 0 : numa->node_of_cpu(cpu);
+    }
+
+    // Spreads workers over the nodes, worker w on node (w + 1) % nodes
+    void _pin_worker(std::size_t worker)
+    {
+        const NumaTopology *numa = _numa.load(std::memory_order_relaxed);
+        std::size_t node = (worker + 1) % numa->node_count();
+        numa->pin(_workers[worker].native_handle(), node);
+        _worker_nodes[worker] = node;
+    }
+
+    static DispatchConfig &_config()
+    {
+        static thread_local DispatchConfig config;
+        return config;
+    }
+
+    void _remove_job(Job *job)
+    {
+        auto job_i = std::find(_jobs.begin(), _jobs.end(), job);
+        if (job_i != _jobs.end()) {
+            _jobs.erase(job_i);
+        }
+    }
+
+    void _worker_loop(std::size_t worker)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _work_cv.wait(lock, [this] { return _stop || !_jobs.empty(); });
+            if (_stop) {
+                return;
+            }
+            Job *job = _jobs.front();
+            std::size_t tid = job->joined++;
+            std::size_t node = _worker_nodes[worker];
+            job->active++;
+            if (job->joined == job->participants) {
+                _jobs.pop_front();
+            }
+            lock.unlock();
+
+            _run_chunks(*job, tid, node);
+
+            lock.lock();
+            _remove_job(job); // exhausted, don't let anyone else join
+            if (job->active.fetch_sub(1, std::memory_order_release) == 1) {
+                _done_cv.notify_all();
+            }
+        }
+    }
+
+  public:
+    /**
+     * @brief Caps the threads of every dispatch the current thread makes on
+     * pool, and picks how it waits for them, until the object is destroyed.
+     * max_threads of 0 keeps the current cap; a larger cap than the pool has
+     * threads grows the pool. Until then current_tid() is 0 outside of the
+     * dispatches' loops, even when opened inside the loop of an outer one,
+     * so state sized by the new cap can be indexed by it.
+     */
+    class ScopedDispatch {
+      private:
+        DispatchConfig _saved;
+        std::size_t _saved_tid;
+
+      public:
+        ScopedDispatch(ThreadPool &pool, std::size_t max_threads,
+                       WaitStrategy wait)
+            : _saved(_config()), _saved_tid(_current_tid())
+        {
+            std::size_t thread_cnt =
+                (max_threads == 0) ? pool.concurrency() : max_threads;
+            pool.reserve(thread_cnt);
+            _config() = {&pool, thread_cnt, wait};
+            _current_tid() = 0;
+        }
+
+        ScopedDispatch(const ScopedDispatch &) = delete;
+        ScopedDispatch &operator=(const ScopedDispatch &) = delete;
+
+        ~ScopedDispatch()
+        {
+            _config() = _saved;
+            _current_tid() = _saved_tid;
+        }
+    };
+
+    explicit ThreadPool(std::size_t worker_cnt) { reserve(worker_cnt + 1); }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _work_cv.notify_all();
+        for (std::thread &t : _workers) {
+            t.join();
+        }
+    }
+
+    // Grows the pool so that dispatches can use thread_cnt threads
+    void reserve(std::size_t thread_cnt)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        while (_workers.size() + 1 < thread_cnt) {
+            _workers.emplace_back(&ThreadPool::_worker_loop, this,
+                                  _workers.size());
+            _worker_nodes.push_back(0);
+            if (_numa.load(std::memory_order_relaxed) != nullptr) {
+                _pin_worker(_workers.size() - 1);
+            }
+        }
+        _worker_cnt = _workers.size();
+    }
+
+    /**
+     * @brief Pins every current and future worker to a node of topology,
+     * spreading them evenly, and splits each later dispatch range into one
+     * contiguous part per node. Threads work through their own node's part
+     * before helping with the others, so memory first touched in a
+     * dispatch stays local to the threads that later sweep the same range.
+     * Only the first call has any effect; the calling thread is not pinned.
+     */
+    void enable_numa(const NumaTopology &topology)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_numa.load(std::memory_order_relaxed) != nullptr) {
+            return;
+        }
+        _topology = std::make_unique<const NumaTopology>(topology);
+        _numa.store(_topology.get(), std::memory_order_release);
+        for (std::size_t w = 0; w < _workers.size(); w++) {
+            _pin_worker(w);
+        }
+    }
+
+    /**
+     * @brief Upper bound on the thread ids handed to a loop body by a
+     * dispatch from the current thread: the calling thread plus the worker
+     * threads, or the cap of an enclosing ScopedDispatch.
+     */
+    std::size_t concurrency() const
+    {
+        const DispatchConfig &config = _config();
+        if (config.pool == this) {
+            return config.max_threads;
+        }
+        return _worker_cnt.load() + 1;
+    }
+
+    /**
+     * @brief tid of the loop body the calling thread is running, as passed
+     * to it by parallel_for, and 0 outside of any since the innermost
+     * ScopedDispatch.
+     */
+    static std::size_t current_tid() { return _current_tid(); }
+
+    /**
+     * @brief Runs func(lo, hi, tid) over [begin, end) in chunks of at most
+     * grain indices and returns once every chunk is done. Threads claim the
+     * next chunk themselves as they finish one. tid is unique per
+     * participating thread within this call and lies in [0, concurrency()).
+     */
+    template <typename Func>
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+                      Func &&func)
+    {
+        typedef typename std::remove_reference<Func>::type FuncType;
+
+        if (begin >= end) {
+            return;
+        }
+        grain = std::max<std::size_t>(grain, 1);
+        std::size_t chunk_cnt = (end - begin + grain - 1) / grain;
+
+        const NumaTopology *numa = _numa.load(std::memory_order_acquire);
+        std::size_t part_cnt = (numa == nullptr) ? 1 : numa->node_count();
+        part_cnt = std::min({part_cnt, MAX_PARTS, chunk_cnt});
+
+        Job job;
+        job.run = [](void *ctx, std::size_t lo, std::size_t hi,
+                     std::size_t tid) {
+            (*static_cast<FuncType *>(ctx))(lo, hi, tid);
+        };
+        job.ctx = const_cast<void *>(static_cast<const void *>(&func));
+        for (std::size_t p = 0; p < part_cnt; p++) {
+            job.parts[p].next = begin + p * chunk_cnt / part_cnt * grain;
+            job.parts[p].end =
+                std::min(end, begin + (p + 1) * chunk_cnt / part_cnt * grain);
+        }
+        job.part_cnt = part_cnt;
+        job.grain = grain;
+        job.participants = std::min(concurrency(), chunk_cnt);
+        job.joined = 1;
+        job.active = 0;
+
+        if (job.participants > 1) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _jobs.push_back(&job);
+            }
+            _work_cv.notify_all();
+        }
+
+        _run_chunks(job, 0, _caller_node());
+
+        if (job.participants > 1) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _remove_job(&job);
+            WaitStrategy wait =
+                (_config().pool == this) ? _config().wait : BLOCK_WAIT;
+            if (wait == BLOCK_WAIT) {
+                _done_cv.wait(lock, [&job] { return job.active == 0; });
+                return;
+            }
+            lock.unlock();
+            while (job.active.load(std::memory_order_acquire) != 0) {
+                if (wait == YIELD_WAIT) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Process-wide pool shared by every engine, created on first use.
+     */
+    static ThreadPool &global()
+    {
+        static ThreadPool pool(
+            std::max<std::size_t>(std::thread::hardware_concurrency(), 1) - 1);
+        return pool;
+    }
+};
+
+/**
+ * @brief Replaces vals with its exclusive prefix sum and returns the total.
+ * Long inputs are scanned as one block per pool thread: block sums first,
+ * then a scan over the block sums, then each block is rewritten in place.
+ * block_sums is scratch space that callers may keep between calls.
+ */
+template <typename T>
+T parallel_exclusive_scan(ThreadPool &pool, std::vector<T> &vals,
+                          std::vector<T> &block_sums)
+{
+    // Below this length a single thread scans faster than a dispatch
+    constexpr std::size_t SERIAL_SCAN_LEN = 1 << 14;
+
+    std::size_t block_cnt = pool.concurrency();
+    if (vals.size() < SERIAL_SCAN_LEN || block_cnt == 1) {
+        T sum = T();
+        for (T &val : vals) {
+            T tmp = val;
+            val = sum;
+            sum += tmp;
+        }
+        return sum;
+    }
+
+    std::size_t block_len = (vals.size() + block_cnt - 1) / block_cnt;
+    auto block_end = [&](std::size_t b) {
+        return std::min((b + 1) * block_len, vals.size());
+    };
+    auto sum_blocks = [&](std::size_t lo, std::size_t hi, std::size_t) {
+        for (std::size_t b = lo; b < hi; b++) {
+            T sum = T();
+            for (std::size_t i = b * block_len; i < block_end(b); i++) {
+                sum += vals[i];
+            }
+            block_sums[b + 1] = sum;
+        }
+    };
+    auto scan_blocks = [&](std::size_t lo, std::size_t hi, std::size_t) {
+        for (std::size_t b = lo; b < hi; b++) {
+            T sum = block_sums[b];
+            for (std::size_t i = b * block_len; i < block_end(b); i++) {
+                T tmp = vals[i];
+                vals[i] = sum;
+                sum += tmp;
+            }
+        }
+    };
+
+    block_sums.assign(block_cnt + 1, T());
+    pool.parallel_for(0, block_cnt, 1, sum_blocks);
+    for (std::size_t b = 0; b < block_cnt; b++) {
+        block_sums[b + 1] += block_sums[b];
+    }
+    pool.parallel_for(0, block_cnt, 1, scan_blocks);
+    return block_sums[block_cnt];
+}
+} // namespace impl
+} // namespace parallel_bfs
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "parallel_bfs.hpp"
+
+namespace parallel_bfs {
+
+// Outcome of validate_bfs_tree, the first rule broken in this order
+enum BfsTreeStatus {
+    TREE_VALID,
+    BAD_ROOT,          // parent[start] != start
+    BAD_PARENT,        // parent is out of range or itself unreached
+    TREE_CYCLE,        // following parents never reaches start
+    MISSING_TREE_EDGE, // no edge parent[v] -> v in the graph
+    LEVEL_GAP,         // an edge u -> v with level(v) > level(u) + 1
+    NOT_SPANNING       // an edge from a reached to an unreached vertex
+};
+
+namespace impl {
+namespace validate {
+// Vertices per chunk of every validation pass
+constexpr std::size_t VERT_CHUNK = 1024;
+
+/**
+ * @brief Levels of the tree vertices by pointer jumping: each round every
+ * vertex adds the distance to its current ancestor and skips to that
+ * ancestor's ancestor, so all vertices reach the root after log2(depth)
+ * rounds. Vertices that still have not reached it sit on a cycle.
+ */
+inline bool _tree_levels(ThreadPool &pool, VertIdx_t start,
+                         const std::vector<VertIdx_t> &parent,
+                         std::vector<std::size_t> &level)
+{
+    std::size_t vert_cnt = parent.size();
+    std::vector<VertIdx_t> anc(parent);
+    std::vector<VertIdx_t> anc_next(vert_cnt);
+    std::vector<std::size_t> level_next(vert_cnt);
+    std::vector<char> moved(pool.concurrency());
+
+    level.resize(vert_cnt);
+    pool.parallel_for(0, vert_cnt, VERT_CHUNK,
+                      [&](std::size_t lo, std::size_t hi, std::size_t) {
+                          for (VertIdx_t v = lo; v < hi; v++) {
+                              if (parent[v] == NO_PARENT) {
+                                  level[v] = UNREACHED;
+                              } else {
+                                  level[v] = (v == start) ? 0 : 1;
+                              }
+                          }
+                      });
+
+    auto jump = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+        for (VertIdx_t v = lo; v < hi; v++) {
+            anc_next[v] = anc[v];
+            level_next[v] = level[v];
+            if (level[v] == UNREACHED || anc[v] == start) {
+                continue;
+            }
+            anc_next[v] = anc[anc[v]];
+            level_next[v] = level[v] + level[anc[v]];
+            moved[tid] = true;
+        }
+    };
+    // A cycle keeps moving forever, but every path is done after this many
+    std::size_t max_rounds = 1;
+    while ((std::size_t(1) << max_rounds) < vert_cnt) {
+        max_rounds++;
+    }
+    for (std::size_t round = 0; round <= max_rounds; round++) {
+        std::fill(moved.begin(), moved.end(), false);
+        pool.parallel_for(0, vert_cnt, VERT_CHUNK, jump);
+        std::swap(anc, anc_next);
+        std::swap(level, level_next);
+        if (std::find(moved.begin(), moved.end(), true) == moved.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace validate
+} // namespace impl
+
+/**
+ * @brief Checks parent, as written through BfsOptions::parent, against the
+ * Graph500 rules for a BFS tree of G rooted at start: every tree edge exists
+ * in G and joins consecutive levels, no edge skips a level, and every vertex
+ * reachable from start is in the tree. Needs no reference traversal; after
+ * the tree levels, a single parallel pass over all edges checks the rest.
+ */
+template <typename GraphType>
+BfsTreeStatus validate_bfs_tree(const GraphType &G, VertIdx_t start,
+                                const std::vector<VertIdx_t> &parent)
+{
+    using namespace impl::validate;
+
+    impl::ThreadPool &pool = impl::ThreadPool::global();
+    impl::ThreadPool::ScopedDispatch dispatch(pool, 0, BLOCK_WAIT);
+    std::size_t vert_cnt = boost::num_vertices(G);
+    // Lowest status found by each thread
+    std::vector<BfsTreeStatus> found(pool.concurrency(), TREE_VALID);
+    auto report = [&](std::size_t tid, BfsTreeStatus status) {
+        if (found[tid] == TREE_VALID || status < found[tid]) {
+            found[tid] = status;
+        }
+    };
+    auto first_found = [&]() {
+        BfsTreeStatus res = TREE_VALID;
+        for (BfsTreeStatus status : found) {
+            if (res == TREE_VALID || (status != TREE_VALID && status < res)) {
+                res = status;
+            }
+        }
+        return res;
+    };
+
+    if (parent.size() != vert_cnt || start >= vert_cnt ||
+        parent[start] != start) {
+        return BAD_ROOT;
+    }
+    pool.parallel_for(0, vert_cnt, VERT_CHUNK,
+                      [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+                          for (VertIdx_t v = lo; v < hi; v++) {
+                              if (parent[v] != NO_PARENT &&
+                                  (parent[v] >= vert_cnt ||
+                                   parent[parent[v]] == NO_PARENT)) {
+                                  report(tid, BAD_PARENT);
+                              }
+                          }
+                      });
+    if (first_found() != TREE_VALID) {
+        return first_found();
+    }
+
+    std::vector<std::size_t> level;
+    if (!_tree_levels(pool, start, parent, level)) {
+        return TREE_CYCLE;
+    }
+
+    // Tree edges seen by the edge pass, written only by the parent's thread
+    std::vector<char> confirmed(vert_cnt, false);
+    confirmed[start] = true;
+    auto check_edges = [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+        for (VertIdx_t u = lo; u < hi; u++) {
+            if (level[u] == UNREACHED) {
+                continue;
+            }
+            const auto &edges = boost::out_edges(u, G);
+            for (auto i = edges.first; i != edges.second; i++) {
+                VertIdx_t v = boost::target(*i, G);
+                if (level[v] == UNREACHED) {
+                    report(tid, NOT_SPANNING);
+                } else if (level[v] > level[u] + 1) {
+                    report(tid, LEVEL_GAP);
+                } else if (parent[v] == u && v != start) {
+                    confirmed[v] = true;
+                }
+            }
+        }
+    };
+    pool.parallel_for(0, vert_cnt, VERT_CHUNK, check_edges);
+    pool.parallel_for(0, vert_cnt, VERT_CHUNK,
+                      [&](std::size_t lo, std::size_t hi, std::size_t tid) {
+                          for (VertIdx_t v = lo; v < hi; v++) {
+                              if (level[v] != UNREACHED && !confirmed[v]) {
+                                  report(tid, MISSING_TREE_EDGE);
+                              }
+                          }
+                      });
+    return first_found();
+}
+} // namespace parallel_bfs
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include <boost/graph/breadth_first_search.hpp>
+
+namespace parallel_bfs {
+namespace impl {
+
+// Whether visitor.end_level() exists, see _end_level
+template <typename VisitorType, typename = void>
+struct HasEndLevel : std::false_type {};
+
+template <typename VisitorType>
+struct HasEndLevel<VisitorType, std::void_t<decltype(std::declval<
+                                    VisitorType &>().end_level())>>
+    : std::true_type {};
+
+// Whether visitor.merge(other) exists for another visitor of the same type
+template <typename VisitorType, typename = void>
+struct HasMerge : std::false_type {};
+
+template <typename VisitorType>
+struct HasMerge<VisitorType,
+                std::void_t<decltype(std::declval<VisitorType &>().merge(
+                    std::declval<VisitorType &>()))>> : std::true_type {};
+
+/**
+ * @brief Whether an event returning Result does anything. Only the no-op
+ * defaults of boost::default_bfs_visitor count as unused; other
+ * boost::bfs_visitor instantiations return the same type but still run their
+ * event visitors.
+ */
+template <typename VisitorType, typename Result> constexpr bool _event_used()
+{
+    typedef boost::graph::bfs_visitor_event_not_overridden Default;
+    return !std::is_same<Result, Default>::value ||
+           !std::is_base_of<boost::default_bfs_visitor, VisitorType>::value;
+}
+
+/**
+ * @brief Which events VisitorType handles when traversing GraphType, so the
+ * engines can compile out the work behind events nobody listens to.
+ * Visitor adaptors specialise it to see through to the visitor they wrap.
+ */
+template <typename VisitorType, typename GraphType> struct EventUse {
+  private:
+    typedef typename boost::graph_traits<GraphType>::vertex_descriptor Vertex;
+    typedef typename boost::graph_traits<GraphType>::edge_descriptor Edge;
+
+    template <typename Result>
+    static constexpr bool _used = _event_used<VisitorType, Result>();
+
+    static VisitorType &_vis();
+    static Vertex _vert();
+    static Edge _edge();
+    static const GraphType &_graph();
+
+  public:
+    static constexpr bool initialize_vertex =
+        _used<decltype(_vis().initialize_vertex(_vert(), _graph()))>;
+    static constexpr bool discover_vertex =
+        _used<decltype(_vis().discover_vertex(_vert(), _graph()))>;
+    static constexpr bool examine_vertex =
+        _used<decltype(_vis().examine_vertex(_vert(), _graph()))>;
+    static constexpr bool examine_edge =
+        _used<decltype(_vis().examine_edge(_edge(), _graph()))>;
+    static constexpr bool tree_edge =
+        _used<decltype(_vis().tree_edge(_edge(), _graph()))>;
+    static constexpr bool non_tree_edge =
+        _used<decltype(_vis().non_tree_edge(_edge(), _graph()))>;
+    static constexpr bool gray_target =
+        _used<decltype(_vis().gray_target(_edge(), _graph()))>;
+    static constexpr bool black_target =
+        _used<decltype(_vis().black_target(_edge(), _graph()))>;
+    static constexpr bool finish_vertex =
+        _used<decltype(_vis().finish_vertex(_vert(), _graph()))>;
+};
+
+// Whether the engines must keep finished marks to tell gray from black
+template <typename VisitorType, typename GraphType>
+constexpr bool _classifies_targets()
+{
+    typedef EventUse<VisitorType, GraphType> Uses;
+    return Uses::gray_target || Uses::black_target;
+}
+
+// Whether vertices have to be finished at all after their expansion
+template <typename VisitorType, typename GraphType>
+constexpr bool _finishes_vertices()
+{
+    return _classifies_targets<VisitorType, GraphType>() ||
+           EventUse<VisitorType, GraphType>::finish_vertex;
+}
+
+/**
+ * @brief Optional event the level-synchronous engines raise from the calling
+ * thread once a level is complete, for visitors that define end_level().
+ */
+template <typename VisitorType> void _end_level(VisitorType &visitor)
+{
+    if constexpr (HasEndLevel<VisitorType>::value) {
+        visitor.end_level();
+    }
+}
+} // namespace impl
+} // namespace parallel_bfs